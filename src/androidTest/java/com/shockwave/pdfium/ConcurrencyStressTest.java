@@ -0,0 +1,101 @@
+package com.shockwave.pdfium;
+
+import android.graphics.Bitmap;
+import android.graphics.Color;
+import android.test.AndroidTestCase;
+import android.util.Log;
+
+import java.util.concurrent.atomic.AtomicReference;
+
+public class ConcurrencyStressTest extends AndroidTestCase {
+    private static final String TAG = "ConcurrencyStressTest";
+    private static final int PAGE_COUNT = 4;
+    private static final int PAGE_SIZE = 100;
+    private static final int THREADS = 8;
+    private static final int ITERATIONS = 200;
+
+    public void testMixedCallsOnTwoDocuments() throws Exception {
+        final PdfiumCore core = new PdfiumCore(getContext());
+        final PdfDocument[] docs = {
+                core.newDocument(TestDocuments.createPdf(PAGE_COUNT, PAGE_SIZE)),
+                core.newDocument(TestDocuments.createPdfWithOutline(PAGE_COUNT, 20, false))
+        };
+        final AtomicReference<Throwable> failure = new AtomicReference<>();
+        Thread[] threads = new Thread[THREADS];
+        try {
+            //Pages and their text are opened up front, threads share them
+            for (PdfDocument doc : docs) {
+                for (int i = 0; i < PAGE_COUNT; i++) {
+                    core.openTextPage(doc, i);
+                }
+            }
+            for (int t = 0; t < THREADS; t++) {
+                final int seed = t;
+                threads[t] = new Thread(new Runnable() {
+                    @Override
+                    public void run() {
+                        try {
+                            exercise(core, docs[seed % docs.length], seed);
+                        } catch (Throwable e) {
+                            failure.compareAndSet(null, e);
+                        }
+                    }
+                });
+                threads[t].start();
+            }
+            for (Thread thread : threads) {
+                thread.join();
+            }
+            if (failure.get() != null) {
+                throw new AssertionError(failure.get());
+            }
+
+            PdfDocument.LockStats engine = core.getEngineLockStats();
+            assertTrue(engine.getAcquisitions() > 0);
+            assertTrue(engine.getContentions() <= engine.getAcquisitions());
+            assertTrue(engine.getMaxWaitNanos() <= engine.getWaitNanos());
+            for (PdfDocument doc : docs) {
+                PdfDocument.LockStats stats = core.getDocumentLockStats(doc);
+                assertTrue(stats.getAcquisitions() > 0);
+                assertTrue(stats.getContentions() <= stats.getAcquisitions());
+            }
+            Log.i(TAG, "Engine lock: " + engine.getContentions() + " of " + engine.getAcquisitions()
+                    + " acquisitions waited, " + engine.getWaitNanos() / 1000000 + " ms in total");
+        } finally {
+            for (PdfDocument doc : docs) {
+                core.closeDocument(doc);
+            }
+        }
+    }
+
+    private void exercise(PdfiumCore core, PdfDocument doc, int seed) {
+        Bitmap bitmap = Bitmap.createBitmap(PAGE_SIZE, PAGE_SIZE, Bitmap.Config.ARGB_8888);
+        try {
+            for (int i = 0; i < ITERATIONS; i++) {
+                int pageIndex = (seed + i) % PAGE_COUNT;
+                switch ((seed + i) % 5) {
+                    case 0:
+                        bitmap.eraseColor(Color.WHITE);
+                        core.renderPageBitmap(doc, bitmap, pageIndex, 0, 0, PAGE_SIZE, PAGE_SIZE);
+                        assertEquals(Color.BLUE, bitmap.getPixel(PAGE_SIZE / 2, PAGE_SIZE / 2));
+                        break;
+                    case 1:
+                        assertTrue(core.textPageCountChars(doc, pageIndex) >= 0);
+                        break;
+                    case 2:
+                        assertNotNull(core.getPageLinks(doc, pageIndex));
+                        break;
+                    case 3:
+                        assertNotNull(core.getTableOfContents(doc));
+                        break;
+                    default:
+                        assertEquals(PAGE_COUNT * 3, core.getAllPageSizes(doc).length);
+                        assertEquals(PAGE_COUNT, core.getPageCount(doc));
+                        break;
+                }
+            }
+        } finally {
+            bitmap.recycle();
+        }
+    }
+}
@@ -0,0 +1,55 @@
+package com.shockwave.pdfium;
+
+import android.graphics.Bitmap;
+import android.graphics.Color;
+import android.os.ParcelFileDescriptor;
+
+import java.io.IOException;
+
+public class DocumentRegistryTest extends PdfFileTestCase {
+    private PdfDocument open(PdfiumCore core) throws IOException {
+        return core.newDocument(ParcelFileDescriptor.open(file, ParcelFileDescriptor.MODE_READ_ONLY));
+    }
+
+    public void testSecondOpenSharesParsedDocument() throws IOException {
+        PdfiumCore core = new PdfiumCore(getContext());
+        core.setRetainedDocumentCount(0);
+
+        PdfDocument first = open(core);
+        long readsAfterOpen = core.getIoStats(first).getCalls();
+        PdfDocument second = open(core);
+        //Shared document has shared counters and nothing was parsed again
+        assertEquals(readsAfterOpen, core.getIoStats(second).getCalls());
+
+        //Closing one handle keeps the other working, its own file descriptor was closed
+        core.closeDocument(first);
+        core.closeDocument(first);
+        assertEquals(pageCount, core.getPageCount(second));
+        core.openPage(second, pageCount - 1);
+        Bitmap bitmap = Bitmap.createBitmap(pageSize, pageSize, Bitmap.Config.ARGB_8888);
+        core.renderPageBitmap(second, bitmap, pageCount - 1, 0, 0, pageSize, pageSize);
+        assertEquals(Color.BLUE, bitmap.getPixel(pageSize / 2, pageSize / 2));
+        bitmap.recycle();
+        core.closeDocument(second);
+
+        //Nothing retained, so the file is parsed again
+        PdfDocument third = open(core);
+        assertTrue(core.getIoStats(third).getCalls() <= readsAfterOpen);
+        core.closeDocument(third);
+    }
+
+    public void testReopenUsesRetainedDocument() throws IOException {
+        PdfiumCore core = new PdfiumCore(getContext());
+        core.setRetainedDocumentCount(1);
+
+        PdfDocument first = open(core);
+        core.openPage(first, 0);
+        long readsAfterPage = core.getIoStats(first).getCalls();
+        core.closeDocument(first);
+
+        PdfDocument reopened = open(core);
+        assertEquals(readsAfterPage, core.getIoStats(reopened).getCalls());
+        core.closeDocument(reopened);
+        core.setRetainedDocumentCount(0);
+    }
+}
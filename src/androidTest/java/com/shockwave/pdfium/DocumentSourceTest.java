@@ -0,0 +1,39 @@
+package com.shockwave.pdfium;
+
+import android.graphics.Bitmap;
+import android.graphics.Color;
+
+import java.io.IOException;
+
+public class DocumentSourceTest extends PdfFileTestCase {
+    public DocumentSourceTest() {
+        super(8, 100);
+    }
+
+    public void testReadsAreBatched() throws IOException {
+        PdfiumCore core = new PdfiumCore(getContext());
+        FileRangeSource source = new FileRangeSource(file, 0);
+        try {
+            PdfDocument doc = core.newDocument(source);
+            try {
+                assertEquals(pageCount, core.getPageCount(doc));
+                Bitmap bitmap = Bitmap.createBitmap(pageSize, pageSize, Bitmap.Config.ARGB_8888);
+                for (int i = 0; i < pageCount; i++) {
+                    core.openPage(doc, i);
+                    core.renderPageBitmap(doc, bitmap, i, 0, 0, pageSize, pageSize);
+                    assertEquals(Color.BLUE, bitmap.getPixel(pageSize / 2, pageSize / 2));
+                }
+                bitmap.recycle();
+
+                PdfDocument.BlockCacheStats stats = core.getBlockCacheStats(doc);
+                assertEquals(source.getRequestCount(), stats.getSyscalls());
+                //Parser reads many small blocks, each Java call serves several of them
+                assertTrue(stats.getSyscalls() < stats.getHits() + stats.getMisses());
+            } finally {
+                core.closeDocument(doc);
+            }
+        } finally {
+            source.close();
+        }
+    }
+}
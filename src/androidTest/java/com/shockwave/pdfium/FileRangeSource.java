@@ -0,0 +1,54 @@
+package com.shockwave.pdfium;
+
+import java.io.File;
+import java.io.IOException;
+import java.io.RandomAccessFile;
+
+/**
+ * Stand-in for a range server: serves byte ranges of a local file, each after given latency,
+ * and counts requests and bytes served.
+ */
+public class FileRangeSource implements DocumentSource {
+    private final RandomAccessFile file;
+    private final long latencyMillis;
+    private int requestCount = 0;
+    private long bytesServed = 0;
+
+    public FileRangeSource(File file, long latencyMillis) throws IOException {
+        this.file = new RandomAccessFile(file, "r");
+        this.latencyMillis = latencyMillis;
+    }
+
+    @Override
+    public long getSize() throws IOException {
+        return file.length();
+    }
+
+    @Override
+    public synchronized int read(long position, byte[] buffer, int offset, int length) throws IOException {
+        try {
+            Thread.sleep(latencyMillis);
+        } catch (InterruptedException e) {
+            throw new IOException("Interrupted");
+        }
+        file.seek(position);
+        int read = file.read(buffer, offset, length);
+        requestCount++;
+        if (read > 0) {
+            bytesServed += read;
+        }
+        return read;
+    }
+
+    public synchronized int getRequestCount() {
+        return requestCount;
+    }
+
+    public synchronized long getBytesServed() {
+        return bytesServed;
+    }
+
+    public void close() throws IOException {
+        file.close();
+    }
+}
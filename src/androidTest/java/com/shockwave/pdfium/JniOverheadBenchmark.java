@@ -0,0 +1,81 @@
+package com.shockwave.pdfium;
+
+import android.os.ParcelFileDescriptor;
+import android.util.Log;
+
+/**
+ * Per-call cost of natives returning objects, logged under tag JniOverheadBenchmark.
+ * Run on the build before natives were registered in JNI_OnLoad to compare against
+ * per-call FindClass / GetMethodID lookups.
+ */
+public class JniOverheadBenchmark extends PdfFileTestCase {
+    private static final String TAG = "JniOverheadBenchmark";
+    private static final int WARMUP = 1000;
+    private static final int ITERATIONS = 20000;
+
+    private PdfiumCore core;
+    private PdfDocument doc;
+
+    @Override
+    protected void setUp() throws Exception {
+        super.setUp();
+        core = new PdfiumCore(getContext());
+        doc = core.newDocument(ParcelFileDescriptor.open(file, ParcelFileDescriptor.MODE_READ_ONLY));
+        core.openPage(doc, 0);
+    }
+
+    @Override
+    protected void tearDown() throws Exception {
+        core.closeDocument(doc);
+        super.tearDown();
+    }
+
+    private interface Call {
+        void run();
+    }
+
+    private void measure(String name, Call call) {
+        for (int i = 0; i < WARMUP; i++) {
+            call.run();
+        }
+        long start = System.nanoTime();
+        for (int i = 0; i < ITERATIONS; i++) {
+            call.run();
+        }
+        long nanosPerCall = (System.nanoTime() - start) / ITERATIONS;
+        Log.i(TAG, name + ": " + nanosPerCall + " ns/call");
+    }
+
+    public void testObjectReturningNatives() {
+        measure("getPageCount (primitive)", new Call() {
+            @Override
+            public void run() {
+                core.getPageCount(doc);
+            }
+        });
+        measure("getPageSize (Size)", new Call() {
+            @Override
+            public void run() {
+                core.getPageSize(doc, 0);
+            }
+        });
+        measure("mapPageCoordsToDevice (Point)", new Call() {
+            @Override
+            public void run() {
+                core.mapPageCoordsToDevice(doc, 0, 0, 0, pageSize, pageSize, 0, 10, 10);
+            }
+        });
+        measure("mapDeviceCoordsToPage (PointF)", new Call() {
+            @Override
+            public void run() {
+                core.mapDeviceCoordsToPage(doc, 0, 0, 0, pageSize, pageSize, 0, 10, 10);
+            }
+        });
+        measure("getAllPageSizes (float[])", new Call() {
+            @Override
+            public void run() {
+                core.getAllPageSizes(doc);
+            }
+        });
+    }
+}
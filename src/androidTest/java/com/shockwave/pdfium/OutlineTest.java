@@ -0,0 +1,63 @@
+package com.shockwave.pdfium;
+
+import android.test.AndroidTestCase;
+import android.util.Log;
+
+import java.io.IOException;
+import java.util.List;
+
+public class OutlineTest extends AndroidTestCase {
+    private static final String TAG = "OutlineTest";
+    private static final int PAGE_COUNT = 3;
+
+    public void testOutlineTree() throws IOException {
+        PdfiumCore core = new PdfiumCore(getContext());
+        PdfDocument doc = core.newDocument(TestDocuments.createPdfWithOutline(PAGE_COUNT, 5, false));
+        try {
+            List<PdfDocument.Bookmark> toc = core.getTableOfContents(doc);
+            assertEquals(5, toc.size());
+            for (int i = 0; i < toc.size(); i++) {
+                PdfDocument.Bookmark entry = toc.get(i);
+                assertEquals("Entry " + i, entry.getTitle());
+                assertEquals(i % PAGE_COUNT, entry.getPageIdx());
+                assertEquals(0, entry.getDepth());
+                assertEquals(1, entry.getChildren().size());
+
+                PdfDocument.Bookmark child = entry.getChildren().get(0);
+                assertEquals("Child " + i, child.getTitle());
+                assertEquals(i % PAGE_COUNT, child.getPageIdx());
+                assertEquals(1, child.getDepth());
+                assertFalse(child.hasChildren());
+            }
+        } finally {
+            core.closeDocument(doc);
+        }
+    }
+
+    public void testLoopingOutlineEnds() throws IOException {
+        PdfiumCore core = new PdfiumCore(getContext());
+        PdfDocument doc = core.newDocument(TestDocuments.createPdfWithOutline(PAGE_COUNT, 4, true));
+        try {
+            List<PdfDocument.Bookmark> toc = core.getTableOfContents(doc);
+            assertEquals(4, toc.size());
+            assertEquals("Entry 3", toc.get(3).getTitle());
+        } finally {
+            core.closeDocument(doc);
+        }
+    }
+
+    public void testLargeOutline() throws IOException {
+        PdfiumCore core = new PdfiumCore(getContext());
+        PdfDocument doc = core.newDocument(TestDocuments.createPdfWithOutline(PAGE_COUNT, 5000, false));
+        try {
+            long start = System.nanoTime();
+            List<PdfDocument.Bookmark> toc = core.getTableOfContents(doc);
+            long nanos = System.nanoTime() - start;
+            assertEquals(5000, toc.size());
+            assertEquals("Child 4999", toc.get(4999).getChildren().get(0).getTitle());
+            Log.i(TAG, "10000 bookmarks read in " + nanos / 1000000 + " ms");
+        } finally {
+            core.closeDocument(doc);
+        }
+    }
+}
@@ -0,0 +1,34 @@
+package com.shockwave.pdfium;
+
+import android.test.AndroidTestCase;
+
+import java.io.File;
+
+/** Test case with a generated plain PDF written to a file in cache dir, deleted after each test */
+public abstract class PdfFileTestCase extends AndroidTestCase {
+    protected final int pageCount;
+    protected final int pageSize;
+    protected File file;
+
+    /** Four pages of 100 x 100 points */
+    protected PdfFileTestCase() {
+        this(4, 100);
+    }
+
+    protected PdfFileTestCase(int pageCount, int pageSize) {
+        this.pageCount = pageCount;
+        this.pageSize = pageSize;
+    }
+
+    @Override
+    protected void setUp() throws Exception {
+        super.setUp();
+        file = TestDocuments.writePdf(getContext(), getClass().getSimpleName() + ".pdf", pageCount, pageSize);
+    }
+
+    @Override
+    protected void tearDown() throws Exception {
+        file.delete();
+        super.tearDown();
+    }
+}
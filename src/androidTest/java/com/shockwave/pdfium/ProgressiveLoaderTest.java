@@ -0,0 +1,60 @@
+package com.shockwave.pdfium;
+
+import android.graphics.Bitmap;
+import android.graphics.Color;
+
+import java.io.IOException;
+
+public class ProgressiveLoaderTest extends PdfFileTestCase {
+    public ProgressiveLoaderTest() {
+        super(16, 200);
+    }
+
+    public void testFirstPageRendersFromRanges() throws IOException {
+        PdfiumCore core = new PdfiumCore(getContext());
+        FileRangeSource source = new FileRangeSource(file, 20);
+        ProgressiveLoader loader = new ProgressiveLoader(core, source);
+        try {
+            PdfDocument doc = loader.open(null);
+            try {
+                assertEquals(pageCount, core.getPageCount(doc));
+
+                int first = core.getFirstAvailablePage(doc);
+                loader.loadPage(doc, first);
+                assertTrue(source.getRequestCount() > 0);
+                assertTrue(source.getBytesServed() <= file.length());
+                assertEquals(core.getAvailableBytes(doc), source.getBytesServed());
+
+                core.openPage(doc, first);
+                Bitmap bitmap = Bitmap.createBitmap(pageSize, pageSize, Bitmap.Config.ARGB_8888);
+                core.renderPageBitmap(doc, bitmap, first, 0, 0, pageSize, pageSize);
+                //Page is filled with blue rectangle
+                assertEquals(Color.BLUE, bitmap.getPixel(pageSize / 2, pageSize / 2));
+                bitmap.recycle();
+            } finally {
+                core.closeDocument(doc);
+            }
+        } finally {
+            source.close();
+        }
+    }
+
+    public void testAllPagesBecomeAvailable() throws IOException {
+        PdfiumCore core = new PdfiumCore(getContext());
+        FileRangeSource source = new FileRangeSource(file, 0);
+        ProgressiveLoader loader = new ProgressiveLoader(core, source);
+        try {
+            PdfDocument doc = loader.open(null);
+            try {
+                for (int i = 0; i < pageCount; i++) {
+                    loader.loadPage(doc, i);
+                    assertTrue(core.openPage(doc, i) != 0);
+                }
+            } finally {
+                core.closeDocument(doc);
+            }
+        } finally {
+            source.close();
+        }
+    }
+}
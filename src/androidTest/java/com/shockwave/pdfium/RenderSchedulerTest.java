@@ -0,0 +1,140 @@
+package com.shockwave.pdfium;
+
+import android.test.AndroidTestCase;
+
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.List;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.TimeUnit;
+
+public class RenderSchedulerTest extends AndroidTestCase {
+    private RenderScheduler scheduler;
+    private final List<String> ran = Collections.synchronizedList(new ArrayList<String>());
+    private final List<String> dropped = Collections.synchronizedList(new ArrayList<String>());
+
+    private class Recording extends RenderScheduler.Request {
+        volatile boolean stale;
+
+        Recording(String key, int priority) {
+            super(key, priority);
+        }
+
+        @Override
+        protected void run() {
+            ran.add((String) getKey());
+        }
+
+        @Override
+        protected boolean isStale() {
+            return stale;
+        }
+
+        @Override
+        protected void onDropped() {
+            dropped.add((String) getKey());
+        }
+    }
+
+    //Holds the only thread until released so that everything else queues up behind it
+    private class Blocker extends RenderScheduler.Request {
+        final CountDownLatch started = new CountDownLatch(1);
+        final CountDownLatch release = new CountDownLatch(1);
+
+        Blocker() {
+            super("blocker", RenderScheduler.PRIORITY_VISIBLE);
+        }
+
+        @Override
+        protected void run() {
+            started.countDown();
+            try {
+                release.await();
+            } catch (InterruptedException e) {
+                Thread.currentThread().interrupt();
+            }
+        }
+    }
+
+    @Override
+    protected void setUp() throws Exception {
+        super.setUp();
+        scheduler = new RenderScheduler(1);
+    }
+
+    @Override
+    protected void tearDown() throws Exception {
+        scheduler.shutdown();
+        super.tearDown();
+    }
+
+    private Blocker block() throws InterruptedException {
+        Blocker blocker = new Blocker();
+        scheduler.submit(blocker);
+        assertTrue(blocker.started.await(5, TimeUnit.SECONDS));
+        return blocker;
+    }
+
+    private void drain() throws InterruptedException {
+        final CountDownLatch done = new CountDownLatch(1);
+        scheduler.submit(new RenderScheduler.Request("drain", RenderScheduler.PRIORITY_PREFETCH) {
+            @Override
+            protected void run() {
+                done.countDown();
+            }
+        });
+        assertTrue(done.await(5, TimeUnit.SECONDS));
+    }
+
+    public void testRunsByPriorityThenSubmission() throws Exception {
+        Blocker blocker = block();
+        scheduler.submit(new Recording("prefetch", RenderScheduler.PRIORITY_PREFETCH));
+        scheduler.submit(new Recording("adjacent", RenderScheduler.PRIORITY_ADJACENT));
+        scheduler.submit(new Recording("visible 1", RenderScheduler.PRIORITY_VISIBLE));
+        scheduler.submit(new Recording("visible 2", RenderScheduler.PRIORITY_VISIBLE));
+        assertEquals(4, scheduler.getStats().getQueueDepth());
+        blocker.release.countDown();
+        drain();
+
+        assertEquals(4, ran.size());
+        assertEquals("visible 1", ran.get(0));
+        assertEquals("visible 2", ran.get(1));
+        assertEquals("adjacent", ran.get(2));
+        assertEquals("prefetch", ran.get(3));
+        assertEquals(1, scheduler.getStats().getRunCount(RenderScheduler.PRIORITY_ADJACENT));
+    }
+
+    public void testEqualKeysCoalesceAndRaisePriority() throws Exception {
+        Blocker blocker = block();
+        RenderScheduler.Request first = scheduler.submit(new Recording("page 3", RenderScheduler.PRIORITY_PREFETCH));
+        scheduler.submit(new Recording("page 2", RenderScheduler.PRIORITY_ADJACENT));
+        RenderScheduler.Request second = scheduler.submit(new Recording("page 3", RenderScheduler.PRIORITY_VISIBLE));
+        assertSame(first, second);
+        assertEquals(RenderScheduler.PRIORITY_VISIBLE, first.getPriority());
+        blocker.release.countDown();
+        drain();
+
+        assertEquals(2, ran.size());
+        assertEquals("page 3", ran.get(0));
+        assertEquals(1, scheduler.getStats().getCoalesced());
+    }
+
+    public void testStaleAndCancelledRequestsAreDropped() throws Exception {
+        Blocker blocker = block();
+        Recording stale = new Recording("stale", RenderScheduler.PRIORITY_ADJACENT);
+        Recording cancelled = new Recording("cancelled", RenderScheduler.PRIORITY_ADJACENT);
+        scheduler.submit(stale);
+        scheduler.submit(cancelled);
+        scheduler.submit(new Recording("kept", RenderScheduler.PRIORITY_ADJACENT));
+        stale.stale = true;
+        cancelled.cancel();
+        blocker.release.countDown();
+        drain();
+
+        assertEquals(1, ran.size());
+        assertEquals("kept", ran.get(0));
+        assertTrue(dropped.contains("stale"));
+        assertTrue(dropped.contains("cancelled"));
+        assertEquals(2, scheduler.getStats().getDropped());
+    }
+}
@@ -0,0 +1,41 @@
+package com.shockwave.pdfium;
+
+import android.graphics.Bitmap;
+import android.graphics.Color;
+import android.os.ParcelFileDescriptor;
+import android.util.Log;
+
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.Future;
+
+public class RenderWorkerPoolTest extends PdfFileTestCase {
+    private static final String TAG = "RenderWorkerPoolTest";
+
+    public RenderWorkerPoolTest() {
+        super(16, 100);
+    }
+
+    public void testPagesRenderedInWorkers() throws Exception {
+        PdfiumCore core = new PdfiumCore(getContext());
+        ParcelFileDescriptor fd = ParcelFileDescriptor.open(file, ParcelFileDescriptor.MODE_READ_ONLY);
+        RenderWorkerPool pool = new RenderWorkerPool(getContext(), core, fd, null, 2);
+        try {
+            long start = System.nanoTime();
+            List<Future<Bitmap>> results = new ArrayList<>();
+            for (int i = 0; i < pageCount; i++) {
+                results.add(pool.renderPage(i, pageSize * 2, pageSize * 2, false));
+            }
+            for (Future<Bitmap> result : results) {
+                Bitmap bitmap = result.get();
+                assertEquals(pageSize * 2, bitmap.getWidth());
+                assertEquals(Color.BLUE, bitmap.getPixel(pageSize, pageSize));
+                bitmap.recycle();
+            }
+            Log.i(TAG, pageCount + " pages rendered in " + (System.nanoTime() - start) / 1000000 + " ms");
+        } finally {
+            pool.close();
+            fd.close();
+        }
+    }
+}
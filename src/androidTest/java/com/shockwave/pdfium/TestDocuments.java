@@ -0,0 +1,117 @@
+package com.shockwave.pdfium;
+
+import android.content.Context;
+
+import java.io.ByteArrayOutputStream;
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.nio.charset.Charset;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.Locale;
+
+/** Documents generated for tests, the repository has no PDF fixtures */
+public class TestDocuments {
+    private static final Charset ASCII = Charset.forName("US-ASCII");
+
+    /** Write {@link #createPdf} to given file name in cache dir, caller deletes it */
+    public static File writePdf(Context context, String name, int pageCount, int pageSize)
+            throws IOException {
+        File file = new File(context.getCacheDir(), name);
+        FileOutputStream out = new FileOutputStream(file);
+        try {
+            out.write(createPdf(pageCount, pageSize));
+        } finally {
+            out.close();
+        }
+        return file;
+    }
+
+    /** Plain PDF with blue pages, content streams are padded so that pages span many ranges */
+    public static byte[] createPdf(int pageCount, int pageSize) throws IOException {
+        List<String> objects = new ArrayList<>();
+        objects.add("<< /Type /Catalog /Pages 2 0 R >>");
+        addPages(objects, pageCount, pageSize);
+        return write(objects);
+    }
+
+    /**
+     * PDF whose outline has entryCount top level bookmarks "Entry i" pointing at page
+     * i % pageCount, each with one child "Child i" at the same page. With loop set, the
+     * sibling chain of the last top level entry leads back to the first one.
+     */
+    public static byte[] createPdfWithOutline(int pageCount, int entryCount, boolean loop)
+            throws IOException {
+        List<String> objects = new ArrayList<>();
+        int outlines = 3 + pageCount * 2;
+        objects.add("<< /Type /Catalog /Pages 2 0 R /Outlines " + outlines + " 0 R >>");
+        addPages(objects, pageCount, 100);
+
+        //Entry i is object outlines + 1 + 2 * i, its child the object after it
+        int first = outlines + 1;
+        int last = outlines + 1 + 2 * (entryCount - 1);
+        objects.add("<< /Type /Outlines /First " + first + " 0 R /Last " + last + " 0 R"
+                + " /Count " + entryCount * 2 + " >>");
+        for (int i = 0; i < entryCount; i++) {
+            int entry = outlines + 1 + 2 * i;
+            String dest = " /Dest [" + (3 + (i % pageCount) * 2) + " 0 R /Fit]";
+            StringBuilder dict = new StringBuilder();
+            dict.append("<< /Title (Entry ").append(i).append(") /Parent ").append(outlines).append(" 0 R")
+                    .append(dest)
+                    .append(" /First ").append(entry + 1).append(" 0 R /Last ").append(entry + 1).append(" 0 R")
+                    .append(" /Count 1");
+            if (i > 0) {
+                dict.append(" /Prev ").append(entry - 2).append(" 0 R");
+            }
+            if (i + 1 < entryCount) {
+                dict.append(" /Next ").append(entry + 2).append(" 0 R");
+            } else if (loop) {
+                dict.append(" /Next ").append(first).append(" 0 R");
+            }
+            objects.add(dict.append(" >>").toString());
+            objects.add("<< /Title (Child " + i + ") /Parent " + entry + " 0 R" + dest + " >>");
+        }
+        return write(objects);
+    }
+
+    private static void addPages(List<String> objects, int pageCount, int pageSize) {
+        StringBuilder kids = new StringBuilder();
+        for (int i = 0; i < pageCount; i++) {
+            kids.append(3 + i * 2).append(" 0 R ");
+        }
+        objects.add("<< /Type /Pages /Count " + pageCount + " /Kids [" + kids + "] >>");
+
+        StringBuilder padding = new StringBuilder();
+        for (int i = 0; i < 512; i++) {
+            padding.append("% padding line to make content stream long\n");
+        }
+        for (int i = 0; i < pageCount; i++) {
+            objects.add("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 " + pageSize + " " + pageSize + "]"
+                    + " /Contents " + (4 + i * 2) + " 0 R >>");
+            String content = "0 0 1 rg 0 0 " + pageSize + " " + pageSize + " re f\n" + padding;
+            objects.add("<< /Length " + content.length() + " >>\nstream\n" + content + "\nendstream");
+        }
+    }
+
+    private static byte[] write(List<String> objects) throws IOException {
+        ByteArrayOutputStream out = new ByteArrayOutputStream();
+        out.write("%PDF-1.4\n".getBytes(ASCII));
+        long[] offsets = new long[objects.size()];
+        for (int i = 0; i < objects.size(); i++) {
+            offsets[i] = out.size();
+            out.write(((i + 1) + " 0 obj\n" + objects.get(i) + "\nendobj\n").getBytes(ASCII));
+        }
+
+        long xref = out.size();
+        StringBuilder trailer = new StringBuilder();
+        trailer.append("xref\n0 ").append(objects.size() + 1).append("\n0000000000 65535 f \n");
+        for (long offset : offsets) {
+            trailer.append(String.format(Locale.US, "%010d 00000 n \n", offset));
+        }
+        trailer.append("trailer\n<< /Size ").append(objects.size() + 1).append(" /Root 1 0 R >>\n")
+                .append("startxref\n").append(xref).append("\n%%EOF\n");
+        out.write(trailer.toString().getBytes(ASCII));
+        return out.toByteArray();
+    }
+}
@@ -0,0 +1,20 @@
+package com.shockwave.pdfium;
+
+import java.io.IOException;
+
+/**
+ * Random access to document bytes which are not in a plain file, e.g. in an encrypted store
+ * or behind a content provider. See {@link PdfiumCore#newDocument(DocumentSource, String)}.
+ */
+public interface DocumentSource {
+    /** Size of the whole document in bytes */
+    long getSize() throws IOException;
+
+    /**
+     * Read up to length bytes at position into buffer, starting at offset.
+     * Called from PDFium with the engine lock held, so it should return quickly and must not
+     * call back into {@link PdfiumCore}.
+     * @return number of bytes read, or -1 at end of data
+     */
+    int read(long position, byte[] buffer, int offset, int length) throws IOException;
+}
@@ -10,7 +10,6 @@ import android.graphics.Paint;
 import android.graphics.Paint.Style;
 import android.graphics.RectF;
 import android.os.Handler;
-import android.os.Message;
 import android.os.ParcelFileDescriptor;
 import android.view.MotionEvent;
 import android.view.View;
@@ -18,9 +17,12 @@ import android.widget.Toast;
 
 
 import java.io.File;
+import java.util.HashMap;
+import java.util.HashSet;
+import java.util.Iterator;
 import java.util.List;
-import java.util.concurrent.ExecutorService;
-import java.util.concurrent.Executors;
+import java.util.Map;
+import java.util.Set;
 
 
 public class PDFView extends View{
@@ -44,8 +46,19 @@ public class PDFView extends View{
   private float pageWidth = 0;
   private float pageHeight = 0;
   final int REDRAW = 0;
+  final int TILE_READY = 1;
+  //When zoomed in beyond pdfBitmap resolution, visible part of page is drawn from tiles
+  private static final int TILE_SIZE = 256;
+  private final Map<Long, Bitmap> tiles = new HashMap<>();
+  private final Set<Long> pendingTiles = new HashSet<>();
+  private volatile float tileZoom = 0f;
+  private volatile int tilePage = -1;
   String filePath = "";
-  ExecutorService cachedThreadPool = Executors.newFixedThreadPool(1);
+  //Visible page and its tiles first, then neighbours; a swipe drops renders of pages left behind
+  private final RenderScheduler scheduler = new RenderScheduler(1);
+  //Pages this far from the requested one are pre-rendered into the render cache
+  private static final int PREFETCH_DISTANCE = 2;
+  private volatile int requestedPage = -1;
   private int bitmapFactor = 2;
   private Runnable longClickedRunable = null;
 
@@ -56,17 +69,29 @@ public class PDFView extends View{
     public void handleMessage(android.os.Message msg) {
       switch(msg.what){
         case REDRAW:
-          int page = msg.arg1;
-          currentIndex = page;
-          if(listener!=null){
-            listener.onPageChange(PDFView.this, currentIndex);
-          }
-          invalidate();
+          onPageReady((PageResult) msg.obj);
+          break;
+        case TILE_READY:
+          onTileReady((TileResult) msg.obj);
           break;
       }
     };
   };
 
+  private static class PageResult {
+    int page;
+    float width;
+    float height;
+    Bitmap bitmap;
+  }
+
+  private static class TileResult {
+    int page;
+    float zoom;
+    long key;
+    Bitmap bitmap;
+  }
+
   public void setTips(List<PDFAreaModel> model){
     this.tipsModel = model;
   }
@@ -80,6 +105,10 @@ public class PDFView extends View{
 
     try{
       core = new PdfiumCore(getContext());
+      //Flipping back to recently viewed pages is served from native render cache
+      core.setRenderCacheSize(Runtime.getRuntime().maxMemory() / 8);
+      //Pages of already viewed documents are served from disk cache
+      core.openDiskCache(new File(getContext().getCacheDir(), "pdfium-tiles"), 64 * 1024 * 1024);
       ParcelFileDescriptor fd = ParcelFileDescriptor.open(new File(filePath), ParcelFileDescriptor.MODE_READ_ONLY);
       document = core.newDocument(fd);
       totalCount = core.getPageCount(document);
@@ -98,21 +127,42 @@ public class PDFView extends View{
     return new float[]{pdfX, pdfY};
   }
 
-  private void parsePage(final int page) throws Exception{
-    core.openPage(document, page);
-    int width = core.getPageWidthPoint(document, page);
-    int height = core.getPageHeightPoint(document, page);
-    pageWidth = width/sdkInnerScale;
-    pageHeight = height/sdkInnerScale;
+  //Renders whole page; shown if it is the requested page, otherwise it only fills the render cache
+  private class PageRequest extends RenderScheduler.Request {
+    private final int page;
 
-    if(pdfBitmap!=null){
-      pdfBitmap.recycle();
-      pdfBitmap = null;
+    PageRequest(int page, int priority) {
+      super("page " + page, priority);
+      this.page = page;
+    }
+
+    @Override
+    protected boolean isStale() {
+      return Math.abs(page - requestedPage) > PREFETCH_DISTANCE;
     }
-    pdfBitmap = Bitmap.createBitmap((int)(pageWidth*bitmapFactor), (int)(pageHeight*bitmapFactor), Config.ARGB_8888);
 
-    pdfBitmap.eraseColor(Color.WHITE);
-    core.renderPageBitmap(document, pdfBitmap, page,0, 0, (int)pageWidth*bitmapFactor, (int)pageHeight*bitmapFactor);
+    @Override
+    protected void run() {
+      if (!document.hasPage(page)) {
+        core.openPage(document, page);
+      }
+      PageResult result = new PageResult();
+      result.page = page;
+      result.width = core.getPageWidthPoint(document, page)/sdkInnerScale;
+      result.height = core.getPageHeightPoint(document, page)/sdkInnerScale;
+
+      Bitmap bitmap = Bitmap.createBitmap((int)(result.width*bitmapFactor), (int)(result.height*bitmapFactor), Config.ARGB_8888);
+      bitmap.eraseColor(Color.WHITE);
+      RenderJob job = core.startRenderPageBitmap(document, bitmap, page, 0, 0,
+          (int)result.width*bitmapFactor, (int)result.height*bitmapFactor, false,
+          RenderScheduler.RENDER_SLICE_MILLIS);
+      if (job == null || !completeRenderJob(core, job) || page != requestedPage) {
+        bitmap.recycle();
+        return;
+      }
+      result.bitmap = bitmap;
+      handler.obtainMessage(REDRAW, result).sendToTarget();
+    }
   }
 
   public void setPage(int page){
@@ -143,6 +193,7 @@ public class PDFView extends View{
   }
 
   public void release(){
+    scheduler.shutdown();
     if(core!=null){
       try{
         if(document!=null) {
@@ -152,6 +203,7 @@ public class PDFView extends View{
           pdfBitmap.recycle();
           pdfBitmap = null;
         }
+        clearTiles();
       }catch(Exception e){
         e.printStackTrace();
       }
@@ -160,24 +212,41 @@ public class PDFView extends View{
   }
 
   private void loadPage(final int page) throws Exception{
-    cachedThreadPool.execute(new Runnable() {
+    requestedPage = page;
+    scheduler.submit(new PageRequest(page, RenderScheduler.PRIORITY_VISIBLE));
+  }
 
-      @Override
-      public void run() {
-        try{
-
-          parsePage(page);
-          Message msg = new Message();
-          msg.what = REDRAW;
-          msg.arg1 = page;
-          handler.sendMessage(msg);
-        }catch(Exception e){
-          e.printStackTrace();
+  private void onPageReady(PageResult result) {
+    if (result.page != requestedPage) {
+      result.bitmap.recycle();
+      return;
+    }
+    if(pdfBitmap!=null){
+      pdfBitmap.recycle();
+    }
+    pdfBitmap = result.bitmap;
+    pageWidth = result.width;
+    pageHeight = result.height;
+    currentIndex = result.page;
+    if(listener!=null){
+      listener.onPageChange(PDFView.this, currentIndex);
+    }
+    invalidate();
+
+    //Flipping on is then served from render cache
+    for (int distance = 1; distance <= PREFETCH_DISTANCE; distance++) {
+      int priority = distance == 1 ? RenderScheduler.PRIORITY_ADJACENT : RenderScheduler.PRIORITY_PREFETCH;
+      for (int neighbour : new int[]{currentIndex - distance, currentIndex + distance}) {
+        if (neighbour >= 0 && neighbour < totalCount) {
+          scheduler.submit(new PageRequest(neighbour, priority));
         }
-
-
       }
-    });
+    }
+  }
+
+  /** Counters of the render queue, e.g. how long the visible page waited behind other renders */
+  public RenderScheduler.Stats getRenderStats() {
+    return scheduler.getStats();
   }
 
 
@@ -200,6 +269,7 @@ public class PDFView extends View{
       matrix.postScale(scale, scale);
       matrix.postTranslate(translateX, translateY);
       canvas.drawBitmap(pdfBitmap, matrix, p);
+      drawTiles(canvas);
     }
     if(tipsModel!=null){
       for(int i = 0;i < tipsModel.size();i++){
@@ -225,6 +295,120 @@ public class PDFView extends View{
 
   }
 
+  private void drawTiles(Canvas canvas) {
+    //Screen pixels per page point, pdfBitmap has bitmapFactor of them
+    float pageScale = scale * bitmapFactor;
+    if (scale <= 1f) {
+      clearTiles();
+      return;
+    }
+
+    //Zoom is quantized to half steps of power of two, so tiles survive small pinch changes
+    float zoom = (float) Math.pow(2, Math.ceil(Math.log(pageScale) / Math.log(2) * 2) / 2);
+    if (zoom != tileZoom || tilePage != currentIndex) {
+      clearTiles();
+      tileZoom = zoom;
+      tilePage = currentIndex;
+    }
+
+    float tileScale = pageScale / zoom;
+    float tileStep = TILE_SIZE * tileScale;
+    int columns = (int) Math.ceil(pageWidth * zoom / TILE_SIZE);
+    int rows = (int) Math.ceil(pageHeight * zoom / TILE_SIZE);
+    int fromX = Math.max(0, (int) Math.floor(-translateX / tileStep));
+    int fromY = Math.max(0, (int) Math.floor(-translateY / tileStep));
+    int toX = Math.min(columns - 1, (int) Math.floor((displayWidth - translateX) / tileStep));
+    int toY = Math.min(rows - 1, (int) Math.floor((displayHeight - translateY) / tileStep));
+
+    //Keep only visible tiles, so memory is bounded by screen size and not by zoom
+    Iterator<Map.Entry<Long, Bitmap>> it = tiles.entrySet().iterator();
+    while (it.hasNext()) {
+      Map.Entry<Long, Bitmap> entry = it.next();
+      int tx = (int) (entry.getKey() & 0xFFFFFFFFL);
+      int ty = (int) (entry.getKey() >>> 32);
+      if (tx < fromX || tx > toX || ty < fromY || ty > toY) {
+        entry.getValue().recycle();
+        it.remove();
+      }
+    }
+
+    canvas.save();
+    canvas.clipRect(translateX, translateY, translateX + pageWidth * pageScale, translateY + pageHeight * pageScale);
+    for (int ty = fromY; ty <= toY; ty++) {
+      for (int tx = fromX; tx <= toX; tx++) {
+        long key = ((long) ty << 32) | tx;
+        Bitmap tile = tiles.get(key);
+        if (tile == null) {
+          requestTile(currentIndex, zoom, tx, ty);
+          continue;
+        }
+        Matrix matrix = new Matrix();
+        matrix.postScale(tileScale, tileScale);
+        matrix.postTranslate(translateX + tx * tileStep, translateY + ty * tileStep);
+        canvas.drawBitmap(tile, matrix, p);
+      }
+    }
+    canvas.restore();
+  }
+
+  private void requestTile(final int page, final float zoom, final int tx, final int ty) {
+    final long key = ((long) ty << 32) | tx;
+    if (!pendingTiles.add(key)) {
+      return;
+    }
+    final TileResult result = new TileResult();
+    result.page = page;
+    result.zoom = zoom;
+    result.key = key;
+    scheduler.submit(new RenderScheduler.Request("tile " + page + " " + zoom + " " + key,
+        RenderScheduler.PRIORITY_VISIBLE) {
+      //Tiles which went stale while waiting in queue are skipped
+      @Override
+      protected boolean isStale() {
+        return zoom != tileZoom || page != tilePage;
+      }
+
+      @Override
+      protected void run() {
+        try {
+          Bitmap bitmap = Bitmap.createBitmap(TILE_SIZE, TILE_SIZE, Config.ARGB_8888);
+          core.renderPageTile(document, bitmap, page, zoom, tx, ty, TILE_SIZE);
+          result.bitmap = bitmap;
+        } catch (Exception e) {
+          e.printStackTrace();
+        }
+        handler.obtainMessage(TILE_READY, result).sendToTarget();
+      }
+
+      @Override
+      protected void onDropped() {
+        handler.obtainMessage(TILE_READY, result).sendToTarget();
+      }
+    });
+  }
+
+  private void onTileReady(TileResult result) {
+    if (result.zoom == tileZoom && result.page == tilePage) {
+      pendingTiles.remove(result.key);
+      if (result.bitmap != null) {
+        tiles.put(result.key, result.bitmap);
+        invalidate();
+      }
+    } else if (result.bitmap != null) {
+      result.bitmap.recycle();
+    }
+  }
+
+  private void clearTiles() {
+    for (Bitmap tile : tiles.values()) {
+      tile.recycle();
+    }
+    tiles.clear();
+    pendingTiles.clear();
+    tileZoom = 0f;
+    tilePage = -1;
+  }
+
   @Override
   public boolean onTouchEvent(MotionEvent event) {
     onPDFTouch(event);
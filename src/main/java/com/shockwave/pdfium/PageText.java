@@ -0,0 +1,93 @@
+package com.shockwave.pdfium;
+
+import android.graphics.RectF;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.CharBuffer;
+import java.nio.FloatBuffer;
+
+/**
+ * Text and character boxes of a whole page, extracted by
+ * {@link PdfiumCore#textPageExtract(PdfDocument, int, PageText)} in one native call.
+ * Characters are indexed like in the other text page methods and read without native calls.
+ * Buffers are kept and grown as needed when the object is reused for other pages.
+ */
+public class PageText {
+    private final boolean withFontSizes;
+    private ByteBuffer textBytes;
+    private ByteBuffer boxBytes;
+    private ByteBuffer fontSizeBytes;
+    private CharBuffer text;
+    private FloatBuffer boxes;
+    private FloatBuffer fontSizes;
+    private int charCount;
+
+    public PageText(boolean withFontSizes) {
+        this.withFontSizes = withFontSizes;
+        ensureCapacity(256);
+    }
+
+    /*package*/ void ensureCapacity(int chars) {
+        if (textBytes != null && text.capacity() >= chars) {
+            return;
+        }
+        textBytes = ByteBuffer.allocateDirect(chars * 2).order(ByteOrder.nativeOrder());
+        boxBytes = ByteBuffer.allocateDirect(chars * 16).order(ByteOrder.nativeOrder());
+        text = textBytes.asCharBuffer();
+        boxes = boxBytes.asFloatBuffer();
+        if (withFontSizes) {
+            fontSizeBytes = ByteBuffer.allocateDirect(chars * 4).order(ByteOrder.nativeOrder());
+            fontSizes = fontSizeBytes.asFloatBuffer();
+        }
+    }
+
+    /*package*/ ByteBuffer getTextBytes() {
+        return textBytes;
+    }
+
+    /*package*/ ByteBuffer getBoxBytes() {
+        return boxBytes;
+    }
+
+    /*package*/ ByteBuffer getFontSizeBytes() {
+        return fontSizeBytes;
+    }
+
+    /*package*/ void setCharCount(int count) {
+        charCount = count;
+    }
+
+    public int getCharCount() {
+        return charCount;
+    }
+
+    /** Whole page text */
+    public String getText() {
+        return getText(0, charCount);
+    }
+
+    public String getText(int startIndex, int length) {
+        char[] chars = new char[length];
+        for (int i = 0; i < length; i++) {
+            chars[i] = text.get(startIndex + i);
+        }
+        return new String(chars);
+    }
+
+    public char getUnicode(int index) {
+        return text.get(index);
+    }
+
+    /** Box of character in page coordinates, written into out */
+    public RectF getCharBox(int index, RectF out) {
+        int offset = index * 4;
+        out.set(boxes.get(offset), boxes.get(offset + 1), boxes.get(offset + 2), boxes.get(offset + 3));
+        return out;
+    }
+
+    /** Font size of character in points, 0 if font sizes were not extracted */
+    public float getFontSize(int index) {
+        return fontSizes != null ? fontSizes.get(index) : 0;
+    }
+}
@@ -3,10 +3,13 @@ package com.shockwave.pdfium;
 import android.graphics.RectF;
 import android.os.ParcelFileDescriptor;
 import android.support.v4.util.ArrayMap;
+import android.support.v4.util.ArraySet;
 
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
 import java.util.List;
 import java.util.Map;
+import java.util.Set;
 
 public class PdfDocument {
 
@@ -57,6 +60,7 @@ public class PdfDocument {
         private List<Bookmark> children = new ArrayList<>();
         String title;
         long pageIdx;
+        int depth;
         long mNativePtr;
 
         public List<Bookmark> getChildren() {
@@ -74,17 +78,28 @@ public class PdfDocument {
         public long getPageIdx() {
             return pageIdx;
         }
+
+        /** Nesting level, 0 for top level bookmarks */
+        public int getDepth() {
+            return depth;
+        }
     }
 
     public static class Link {
         private RectF bounds;
         private Integer destPageIdx;
         private String uri;
+        private float[] quadPoints;
 
         public Link(RectF bounds, Integer destPageIdx, String uri) {
+            this(bounds, destPageIdx, uri, new float[0]);
+        }
+
+        public Link(RectF bounds, Integer destPageIdx, String uri, float[] quadPoints) {
             this.bounds = bounds;
             this.destPageIdx = destPageIdx;
             this.uri = uri;
+            this.quadPoints = quadPoints;
         }
 
         public Integer getDestPageIdx() {
@@ -98,13 +113,203 @@ public class PdfDocument {
         public RectF getBounds() {
             return bounds;
         }
+
+        /**
+         * Active areas of link in page coordinates, 8 values (x1, y1, ... x4, y4) per
+         * quadrilateral. Empty if link only has bounds.
+         */
+        public float[] getQuadPoints() {
+            return quadPoints;
+        }
+    }
+
+    /** Totals of {@link PdfiumCore#renderPageBitmap} stages, times in nanoseconds */
+    public static class RenderStats {
+        long renderCount;
+        long formRenderCount;
+        long conversionPasses;
+        long cacheHits;
+        long cacheMisses;
+        long diskCacheHits;
+        long diskCacheMisses;
+        long formSkipCount;
+        long lockNanos;
+        long pageNanos;
+        long formNanos;
+        long convertNanos;
+
+        public long getRenderCount() {
+            return renderCount;
+        }
+
+        public long getFormRenderCount() {
+            return formRenderCount;
+        }
+
+        /** Full-frame passes over pixels done after rasterization, at most one per render */
+        public long getConversionPasses() {
+            return conversionPasses;
+        }
+
+        /** Renders served from render cache, they are not included in render count */
+        public long getCacheHits() {
+            return cacheHits;
+        }
+
+        public long getCacheMisses() {
+            return cacheMisses;
+        }
+
+        /** Renders served from disk cache, they are not included in render count */
+        public long getDiskCacheHits() {
+            return diskCacheHits;
+        }
+
+        public long getDiskCacheMisses() {
+            return diskCacheMisses;
+        }
+
+        /** Renders which asked for forms but took form-free path, as document has no AcroForm */
+        public long getFormSkipCount() {
+            return formSkipCount;
+        }
+
+        /** Time spent locking bitmap pixels and preparing render target */
+        public long getLockNanos() {
+            return lockNanos;
+        }
+
+        /** Time spent rasterizing page content */
+        public long getPageNanos() {
+            return pageNanos;
+        }
+
+        /** Time spent drawing form widgets */
+        public long getFormNanos() {
+            return formNanos;
+        }
+
+        /** Time spent converting pixels into bitmap format and unlocking bitmap */
+        public long getConvertNanos() {
+            return convertNanos;
+        }
+    }
+
+    public static class BlockCacheStats {
+        long hits;
+        long misses;
+        long syscalls;
+        long bytesRead;
+
+        /** Blocks requested by parser and served from memory */
+        public long getHits() {
+            return hits;
+        }
+
+        /** Blocks requested by parser which had to be read from file */
+        public long getMisses() {
+            return misses;
+        }
+
+        /**
+         * Read syscalls made, or calls into {@link DocumentSource}. Misses are batched and read
+         * ahead so there are fewer of them
+         */
+        public long getSyscalls() {
+            return syscalls;
+        }
+
+        public long getBytesRead() {
+            return bytesRead;
+        }
+    }
+
+    public static class IoStats {
+        /** Bucket i counts reads which took less than 2^i microseconds, the last one all slower reads */
+        public static final int LATENCY_BUCKETS = 16;
+        /** Number of equal file ranges in offset heatmap */
+        public static final int OFFSET_BUCKETS = 32;
+
+        long calls;
+        long bytes;
+        long failures;
+        long totalNanos;
+        long maxNanos;
+        final long[] latencyHistogram = new long[LATENCY_BUCKETS];
+        final long[] offsetHeatmap = new long[OFFSET_BUCKETS];
+
+        /** Reads made by PDFium, while loading document and later while loading and rendering pages */
+        public long getCalls() {
+            return calls;
+        }
+
+        /** Bytes read, more than file size means parts of file were read repeatedly */
+        public long getBytes() {
+            return bytes;
+        }
+
+        public long getFailures() {
+            return failures;
+        }
+
+        /** Time spent in reads, including caches between PDFium and storage */
+        public long getTotalNanos() {
+            return totalNanos;
+        }
+
+        public long getMaxNanos() {
+            return maxNanos;
+        }
+
+        /** Read counts by latency, see {@link #LATENCY_BUCKETS} */
+        public long[] getLatencyHistogram() {
+            return latencyHistogram.clone();
+        }
+
+        /**
+         * Read counts by where in file they start, file is split into {@link #OFFSET_BUCKETS} ranges.
+         * Cross-reference tables spread over the file show up as reads in many buckets.
+         */
+        public long[] getOffsetHeatmap() {
+            return offsetHeatmap.clone();
+        }
+    }
+
+    public static class LockStats {
+        long acquisitions;
+        long contentions;
+        long waitNanos;
+        long maxWaitNanos;
+
+        public long getAcquisitions() {
+            return acquisitions;
+        }
+
+        /** Acquisitions which found the lock held by another thread and had to wait */
+        public long getContentions() {
+            return contentions;
+        }
+
+        /** Total time threads waited for the lock */
+        public long getWaitNanos() {
+            return waitNanos;
+        }
+
+        public long getMaxWaitNanos() {
+            return maxWaitNanos;
+        }
     }
 
     /*package*/ PdfDocument() {
     }
 
+    //Guards Java state of this handle below, native state of document has its own lock
+    /*package*/ final Object mLock = new Object();
+
     /*package*/ long mNativeDocPtr;
     /*package*/ ParcelFileDescriptor parcelFileDescriptor;
+    //Data of document opened from direct buffer, read by native code while document is open
+    /*package*/ ByteBuffer mDirectBuffer;
 
     /*package*/ final Map<Integer, Long> mNativePagesPtr = new ArrayMap<>();
 
@@ -113,4 +318,6 @@ public class PdfDocument {
     }
 
     /*package*/ final Map<Integer, Long> mNativeTextPagesPtr = new ArrayMap<>();
+
+    /*package*/ final Set<RenderJob> mRenderJobs = new ArraySet<>();
 }
@@ -11,19 +11,45 @@ import android.view.Surface;
 
 import com.shockwave.pdfium.util.Size;
 
+import java.io.File;
 import java.io.FileDescriptor;
 import java.io.IOException;
 import java.lang.reflect.Field;
 import java.nio.ByteBuffer;
 import java.nio.ByteOrder;
 import java.util.ArrayList;
+import java.util.Arrays;
 import java.util.List;
 
+/**
+ * Entry point to PDFium.
+ * <p>
+ * Methods can be called from any thread. Calls for different documents run in parallel except
+ * while PDFium itself works, which it does for one thread at a time since it is not thread-safe;
+ * long renders give it up between slices. Calls for the same document are serialized. A
+ * document must not be closed while other threads still use it, and {@link DocumentSource}
+ * reads must not call back into this class.
+ */
 public class PdfiumCore {
     private static final String TAG = PdfiumCore.class.getName();
     private static final Class FD_CLASS = FileDescriptor.class;
     private static final String FD_FIELD_NAME = "descriptor";
 
+    /** Read file through block cache, see {@link #setBlockCacheSize(long)} */
+    public static final int OPEN_MODE_READ = 0;
+    /** Map file into memory */
+    public static final int OPEN_MODE_MMAP = 1;
+
+    /** Progressive loading status: data is corrupted or cannot be checked */
+    public static final int DATA_ERROR = -1;
+    /** Progressive loading status: more data is needed, see {@link #getRequestedRanges(PdfDocument)} */
+    public static final int DATA_NOT_AVAILABLE = 0;
+    /** Progressive loading status: data is available */
+    public static final int DATA_AVAILABLE = 1;
+
+    /** Longest side of thumbnail atlas, within texture size limits of common GPUs */
+    public static final int MAX_THUMBNAIL_ATLAS_SIZE = 4096;
+
     static {
         try {
             System.loadLibrary("c++_shared");
@@ -36,21 +62,45 @@ public class PdfiumCore {
         }
     }
 
-    private native long nativeOpenDocument(int fd, String password);
+    private native long nativeOpenDocument(int fd, String password, boolean mapped);
 
     private native long nativeOpenMemDocument(byte[] data, String password);
 
+    private native long nativeOpenDirectBufferDocument(ByteBuffer buffer, int offset, int length,
+                                                       String password);
+
+    private native long nativeOpenSourceDocument(DocumentSource source, long size, String password);
+
+    private native long nativeOpenProgressiveDocument(long fileSize);
+
+    private native boolean nativeProgressiveAddData(long docPtr, long offset, byte[] data,
+                                                    int dataOffset, int length);
+
+    private native long[] nativeProgressiveGetRequests(long docPtr);
+
+    private native long nativeProgressiveGetAvailableBytes(long docPtr);
+
+    private native int nativeProgressiveLoad(long docPtr, String password);
+
+    private native int nativeProgressiveIsPageAvail(long docPtr, int pageIndex);
+
+    private native int nativeProgressiveGetFirstPage(long docPtr);
+
     private native void nativeCloseDocument(long docPtr);
 
+    private native void nativeSetRetainedDocuments(int count);
+
     private native int nativeGetPageCount(long docPtr);
 
+    private native boolean nativeHasForm(long docPtr);
+
     private native long nativeLoadPage(long docPtr, int pageIndex);
 
     private native long[] nativeLoadPages(long docPtr, int fromIndex, int toIndex);
 
-    private native void nativeClosePage(long pagePtr);
+    private native void nativeClosePage(long docPtr, long pagePtr);
 
-    private native void nativeClosePages(long[] pagesPtr);
+    private native void nativeClosePages(long docPtr, long[] pagesPtr);
 
     private native int nativeGetPageWidthPixel(long pagePtr, int dpi);
 
@@ -67,26 +117,84 @@ public class PdfiumCore {
                                          int drawSizeHor, int drawSizeVer,
                                          boolean renderAnnot);
 
-    private native void nativeRenderPageBitmap(long pagePtr, Bitmap bitmap, int dpi,
+    private native void nativeRenderPageBitmap(long docPtr, long pagePtr, int pageIndex,
+                                               Bitmap bitmap, int dpi,
                                                int startX, int startY,
                                                int drawSizeHor, int drawSizeVer,
-                                               boolean renderAnnot);
+                                               boolean renderAnnot, boolean renderForm,
+                                               boolean dither);
 
-    // With form support
-    private native void nativeRenderPageBitmap(long docPtr, long pagePtr, Bitmap bitmap, int dpi,
-        int startX, int startY,
-        int drawSizeHor, int drawSizeVer,
-        boolean renderAnnot);
+    private native void nativeRenderPageTile(long docPtr, long pagePtr, int pageIndex, float zoom,
+                                             int tileX, int tileY, int tileSize, Bitmap bitmap,
+                                             boolean renderAnnot, boolean renderForm,
+                                             boolean dither);
 
-    private native String nativeGetDocumentMetaText(long docPtr, String tag);
+    private native int[] nativeLayoutThumbnails(long docPtr, int fromPage, int toPage, int maxEdge,
+                                                int maxAtlas);
+
+    private native int nativeRenderThumbnails(long docPtr, int fromPage, int toPage, int[] layout,
+                                              Bitmap bitmap, boolean renderAnnot);
+
+    private native long nativeRenderJobStart(long docPtr, long pagePtr, int pageIndex, Bitmap bitmap,
+                                             int startX, int startY,
+                                             int drawSizeHor, int drawSizeVer,
+                                             boolean renderAnnot, boolean dither,
+                                             long budgetNanos);
+
+    private native int nativeRenderJobGetStatus(long jobPtr);
+
+    private native int nativeRenderJobResume(long jobPtr, long budgetNanos);
+
+    private native void nativeRenderJobCancel(long jobPtr);
+
+    private native void nativeRenderJobClose(long jobPtr);
+
+    private native long[] nativeGetRenderStats(long docPtr);
+
+    private native long[] nativeGetIoStats(long docPtr);
+
+    private native void nativeSetRenderCacheSize(long bytes);
+
+    private native long nativeGetRenderCacheUsed();
+
+    private native void nativeSetBlockCacheSize(long bytes);
+
+    private native long[] nativeGetBlockCacheStats(long docPtr);
+
+    private native long[] nativeGetEngineLockStats();
+
+    private native long[] nativeGetDocumentLockStats(long docPtr);
+
+    private native int nativeCreateSharedMemory(int size);
+
+    private native ByteBuffer nativeMapSharedMemory(int fd, int size);
+
+    private native void nativeUnmapSharedMemory(ByteBuffer buffer);
+
+    private native boolean nativeRenderPageToBuffer(long docPtr, long pagePtr, ByteBuffer buffer,
+                                                    int width, int height, boolean renderAnnot);
+
+    private native boolean nativeOpenDiskCache(String dir, long bytes);
+
+    private native void nativeCloseDiskCache();
+
+    private native long nativeGetDiskCacheUsed();
 
-    private native Long nativeGetFirstChildBookmark(long docPtr, Long bookmarkPtr);
+    private native long nativeGetFileFingerprint(int fd);
 
-    private native Long nativeGetSiblingBookmark(long docPtr, long bookmarkPtr);
+    private native long nativeGetDocumentFingerprint(long docPtr);
 
-    private native String nativeGetBookmarkTitle(long bookmarkPtr);
+    private native int[] nativeFindCachedPage(long fingerprint, int pageIndex, boolean renderAnnot);
 
-    private native long nativeGetBookmarkDestIndex(long docPtr, long bookmarkPtr);
+    private native boolean nativeRenderCachedPageBitmap(long fingerprint, int pageIndex, Bitmap bitmap,
+                                                        int startX, int startY,
+                                                        int drawSizeHor, int drawSizeVer,
+                                                        boolean renderAnnot, boolean renderForm,
+                                                        boolean dither);
+
+    private native String nativeGetDocumentMetaText(long docPtr, String tag);
+
+    private native Object[] nativeGetOutline(long docPtr);
 
     private native long nativeLoadTextPage(long docPtr, long pagePtr);
 
@@ -100,6 +208,9 @@ public class PdfiumCore {
 
     private native double[] nativeTextGetCharBox(long textPagePtr, int index);
 
+    private native int nativeTextExtract(long textPagePtr, ByteBuffer text, ByteBuffer boxes,
+                                         ByteBuffer fontSizes);
+
     private native int nativeTextGetCharIndexAtPos(long textPagePtr, double x, double y, double xTolerance, double yTolerance);
 
     private native int nativeTextCountRects(long textPagePtr, int start_index, int count);
@@ -110,13 +221,9 @@ public class PdfiumCore {
 
     private native Size nativeGetPageSizeByIndex(long docPtr, int pageIndex, int dpi);
 
-    private native long[] nativeGetPageLinks(long pagePtr);
-
-    private native Integer nativeGetDestPageIndex(long docPtr, long linkPtr);
+    private native float[] nativeGetAllPageSizes(long docPtr);
 
-    private native String nativeGetLinkURI(long docPtr, long linkPtr);
-
-    private native RectF nativeGetLinkRect(long linkPtr);
+    private native Object[] nativeGetPageLinkTable(long docPtr, long pagePtr);
 
     private native Point nativePageCoordsToDevice(long pagePtr, int startX, int startY, int sizeX,
                                                   int sizeY, int rotate, double pageX, double pageY);
@@ -125,10 +232,9 @@ public class PdfiumCore {
         int sizeY, int rotate, int deviceX, int deviceY);
 
 
-    /* synchronize native methods */
-    private static final Object lock = new Object();
     private static Field mFdField = null;
     private int mCurrentDpi;
+    private volatile boolean mDither565 = false;
 
     public static int getNumFd(ParcelFileDescriptor fdObj) {
         try {
@@ -148,12 +254,50 @@ public class PdfiumCore {
     }
 
 
+    /** Create shared memory of given size which can be passed to other process, null on error */
+    /*package*/ ParcelFileDescriptor createSharedMemory(int size) {
+        int fd = nativeCreateSharedMemory(size);
+        return fd < 0 ? null : ParcelFileDescriptor.adoptFd(fd);
+    }
+
+    /** Map shared memory into direct buffer, null on error; release it with {@link #unmapSharedMemory(ByteBuffer)} */
+    /*package*/ ByteBuffer mapSharedMemory(ParcelFileDescriptor fd, int size) {
+        return nativeMapSharedMemory(fd.getFd(), size);
+    }
+
+    /*package*/ void unmapSharedMemory(ByteBuffer buffer) {
+        nativeUnmapSharedMemory(buffer);
+    }
+
+    /**
+     * Render whole opened page scaled to width x height straight into direct buffer, as
+     * ARGB_8888 pixels for {@link Bitmap#copyPixelsFromBuffer}. No render or disk cache is used.
+     *
+     * @return false if page is not opened or buffer is too small
+     */
+    /*package*/ boolean renderPageToBuffer(PdfDocument doc, int pageIndex, ByteBuffer buffer,
+                                           int width, int height, boolean renderAnnot) {
+        synchronized (doc.mLock) {
+            Long pagePtr = doc.mNativePagesPtr.get(pageIndex);
+            return pagePtr != null &&
+                    nativeRenderPageToBuffer(doc.mNativeDocPtr, pagePtr, buffer, width, height, renderAnnot);
+        }
+    }
+
     /** Context needed to get screen density */
     public PdfiumCore(Context ctx) {
         mCurrentDpi = ctx.getResources().getDisplayMetrics().densityDpi;
         Log.d(TAG, "Starting PdfiumAndroid " + BuildConfig.VERSION_NAME);
     }
 
+    /**
+     * Enable ordered dithering when rendering into RGB_565 bitmaps.
+     * It hides banding on gradients and scanned images.
+     */
+    public void setRgb565Dithering(boolean dither) {
+        mDither565 = dither;
+    }
+
     /** Create new document from file */
     public PdfDocument newDocument(ParcelFileDescriptor fd) throws IOException {
         return newDocument(fd, null);
@@ -161,11 +305,23 @@ public class PdfiumCore {
 
     /** Create new document from file with password */
     public PdfDocument newDocument(ParcelFileDescriptor fd, String password) throws IOException {
+        return newDocument(fd, password, OPEN_MODE_READ);
+    }
+
+    /**
+     * Create new document from file with password, using given open mode.<br>
+     * With {@link #OPEN_MODE_MMAP} file is mapped into memory and PDFium reads are served from
+     * the mapping without syscalls, which pays off on large files. File must not be truncated
+     * while document is open. If mapping fails, document is opened with {@link #OPEN_MODE_READ}.<br>
+     * If the same unchanged file (device, inode, size and modification time) is already open
+     * with the same password, or was closed recently (see {@link #setRetainedDocumentCount(int)}),
+     * its parsed document is shared instead of parsing the file again. Every returned
+     * {@link PdfDocument} is a separate handle and must be closed on its own.
+     */
+    public PdfDocument newDocument(ParcelFileDescriptor fd, String password, int openMode) throws IOException {
         PdfDocument document = new PdfDocument();
         document.parcelFileDescriptor = fd;
-        synchronized (lock) {
-            document.mNativeDocPtr = nativeOpenDocument(getNumFd(fd), password);
-        }
+        document.mNativeDocPtr = nativeOpenDocument(getNumFd(fd), password, openMode == OPEN_MODE_MMAP);
 
         return document;
     }
@@ -175,26 +331,154 @@ public class PdfiumCore {
         return newDocument(data, null);
     }
 
-    /** Create new document from bytearray with password */
+    /**
+     * Create new document from bytearray with password.<br>
+     * Document keeps one native copy of data until it is closed.
+     */
     public PdfDocument newDocument(byte[] data, String password) throws IOException {
         PdfDocument document = new PdfDocument();
-        synchronized (lock) {
-            document.mNativeDocPtr = nativeOpenMemDocument(data, password);
+        document.mNativeDocPtr = nativeOpenMemDocument(data, password);
+        return document;
+    }
+
+    /** Create new document from remaining bytes of direct buffer */
+    public PdfDocument newDocument(ByteBuffer buffer) throws IOException {
+        return newDocument(buffer, null);
+    }
+
+    /**
+     * Create new document from remaining bytes of direct buffer with password.<br>
+     * Data is read in place without copying, buffer content must not change until document
+     * is closed. Document keeps reference to buffer, so it stays valid meanwhile.
+     */
+    public PdfDocument newDocument(ByteBuffer buffer, String password) throws IOException {
+        if (!buffer.isDirect()) {
+            throw new IllegalArgumentException("Buffer must be direct");
         }
+        PdfDocument document = new PdfDocument();
+        document.mDirectBuffer = buffer;
+        document.mNativeDocPtr = nativeOpenDirectBufferDocument(buffer, buffer.position(),
+                buffer.remaining(), password);
+        return document;
+    }
+
+    /**
+     * Create new document from random access source. See
+     * {@link #newDocument(DocumentSource, String)} for the threading rules of its reads.
+     */
+    public PdfDocument newDocument(DocumentSource source) throws IOException {
+        return newDocument(source, null);
+    }
+
+    /**
+     * Create new document from random access source with password.<br>
+     * Source is read in aligned chunks through the block cache (see {@link #setBlockCacheSize(long)}),
+     * so the parser's many small reads do not each call into Java. Reads happen on threads
+     * calling into this class, while document is open; pages of such documents are not
+     * written to the disk cache.<br>
+     * Reads that miss the cache run inside PDFium while the process-wide engine lock is held,
+     * so a slow source stalls work on every other document, and calling back into this class
+     * from {@link DocumentSource#read} deadlocks. The whole document, when it fits in half
+     * the block cache, or else its first and last chunks are read before the lock is taken.
+     */
+    public PdfDocument newDocument(DocumentSource source, String password) throws IOException {
+        PdfDocument document = new PdfDocument();
+        long size = source.getSize();
+        document.mNativeDocPtr = nativeOpenSourceDocument(source, size, password);
+        return document;
+    }
+
+    /**
+     * Create document whose data arrives over time, e.g. downloaded in ranges.<br>
+     * Feed data with {@link #addDocumentData(PdfDocument, long, byte[], int, int)} and call
+     * {@link #loadProgressiveDocument(PdfDocument, String)} until it returns {@link #DATA_AVAILABLE};
+     * ranges the parser still needs are reported by {@link #getRequestedRanges(PdfDocument)}.
+     * Linearized documents become available with their first page, before the whole file.
+     * Other pages may be opened only after {@link #isPageAvailable(PdfDocument, int)} said so.
+     * See {@link ProgressiveLoader} for a driver of this loop.
+     */
+    public PdfDocument newProgressiveDocument(long fileSize) throws IOException {
+        PdfDocument document = new PdfDocument();
+        document.mNativeDocPtr = nativeOpenProgressiveDocument(fileSize);
         return document;
     }
 
+    /**
+     * Add bytes of progressive document at offset in file. Can be called from any thread,
+     * e.g. the one doing downloads, but not concurrently with {@link #closeDocument(PdfDocument)}.
+     */
+    public void addDocumentData(PdfDocument doc, long offset, byte[] data, int dataOffset, int length) {
+        //Native data source has its own lock, parsing is not blocked by copying
+        if (!nativeProgressiveAddData(doc.mNativeDocPtr, offset, data, dataOffset, length)) {
+            throw new IllegalArgumentException("Data is past end of file");
+        }
+    }
+
+    /**
+     * Byte ranges of progressive document requested by the parser since last call,
+     * as offset and size pairs. Ranges already present are left out.
+     */
+    public long[] getRequestedRanges(PdfDocument doc) {
+        long[] ranges = nativeProgressiveGetRequests(doc.mNativeDocPtr);
+        return ranges != null ? ranges : new long[0];
+    }
+
+    /** Number of bytes of progressive document received so far */
+    public long getAvailableBytes(PdfDocument doc) {
+        return nativeProgressiveGetAvailableBytes(doc.mNativeDocPtr);
+    }
+
+    /**
+     * Check whether progressive document can be loaded and load it if so.
+     * @return {@link #DATA_AVAILABLE} once document is loaded, {@link #DATA_NOT_AVAILABLE}
+     * when more data is needed or {@link #DATA_ERROR}
+     * @throws IOException if data is available but document cannot be opened
+     */
+    public int loadProgressiveDocument(PdfDocument doc, String password) throws IOException {
+        synchronized (doc.mLock) {
+            return nativeProgressiveLoad(doc.mNativeDocPtr, password);
+        }
+    }
+
+    /**
+     * Check whether page of loaded progressive document has all its data, missing ranges
+     * are requested. Always {@link #DATA_AVAILABLE} for other documents.
+     */
+    public int isPageAvailable(PdfDocument doc, int pageIndex) {
+        synchronized (doc.mLock) {
+            return nativeProgressiveIsPageAvail(doc.mNativeDocPtr, pageIndex);
+        }
+    }
+
+    /** First page of loaded linearized document, which is available first; 0 for other documents */
+    public int getFirstAvailablePage(PdfDocument doc) {
+        synchronized (doc.mLock) {
+            return nativeProgressiveGetFirstPage(doc.mNativeDocPtr);
+        }
+    }
+
     /** Get total numer of pages in document */
     public int getPageCount(PdfDocument doc) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             return nativeGetPageCount(doc.mNativeDocPtr);
         }
     }
 
+    /**
+     * Whether document may have interactive form fields. Documents without AcroForm are
+     * rendered on a form-free path even if form rendering is requested. Found out on first
+     * call or first form render, which parse the document once more.
+     */
+    public boolean hasForm(PdfDocument doc) {
+        synchronized (doc.mLock) {
+            return nativeHasForm(doc.mNativeDocPtr);
+        }
+    }
+
     /** Open page and store native pointer in {@link PdfDocument} */
     public long openPage(PdfDocument doc, int pageIndex) {
         long pagePtr;
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             pagePtr = nativeLoadPage(doc.mNativeDocPtr, pageIndex);
             doc.mNativePagesPtr.put(pageIndex, pagePtr);
             return pagePtr;
@@ -202,10 +486,21 @@ public class PdfiumCore {
 
     }
 
+    /** Close page opened with {@link #openPage(PdfDocument, int)} along with its text page */
+    /*package*/ void closePage(PdfDocument doc, int pageIndex) {
+        synchronized (doc.mLock) {
+            closeTextPage(doc, pageIndex);
+            Long pagePtr = doc.mNativePagesPtr.remove(pageIndex);
+            if (pagePtr != null) {
+                nativeClosePage(doc.mNativeDocPtr, pagePtr);
+            }
+        }
+    }
+
     /** Open range of pages and store native pointers in {@link PdfDocument} */
     public long[] openPage(PdfDocument doc, int fromIndex, int toIndex) {
         long[] pagesPtr;
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             pagesPtr = nativeLoadPages(doc.mNativeDocPtr, fromIndex, toIndex);
             int pageIndex = fromIndex;
             for (long page : pagesPtr) {
@@ -223,7 +518,7 @@ public class PdfiumCore {
      * This method requires page to be opened.
      */
     public int getPageWidth(PdfDocument doc, int index) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             Long pagePtr;
             if ((pagePtr = doc.mNativePagesPtr.get(index)) != null) {
                 return nativeGetPageWidthPixel(pagePtr, mCurrentDpi);
@@ -237,7 +532,7 @@ public class PdfiumCore {
      * This method requires page to be opened.
      */
     public int getPageHeight(PdfDocument doc, int index) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             Long pagePtr;
             if ((pagePtr = doc.mNativePagesPtr.get(index)) != null) {
                 return nativeGetPageHeightPixel(pagePtr, mCurrentDpi);
@@ -251,7 +546,7 @@ public class PdfiumCore {
      * This method requires page to be opened.
      */
     public int getPageWidthPoint(PdfDocument doc, int index) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             Long pagePtr;
             if ((pagePtr = doc.mNativePagesPtr.get(index)) != null) {
                 return nativeGetPageWidthPoint(pagePtr);
@@ -265,7 +560,7 @@ public class PdfiumCore {
      * This method requires page to be opened.
      */
     public int getPageHeightPoint(PdfDocument doc, int index) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             Long pagePtr;
             if ((pagePtr = doc.mNativePagesPtr.get(index)) != null) {
                 return nativeGetPageHeightPoint(pagePtr);
@@ -276,14 +571,27 @@ public class PdfiumCore {
 
     /**
      * Get size of page in pixels.<br>
-     * This method does not require given page to be opened.
+     * This method does not require given page to be opened. To lay out many pages use
+     * {@link #getAllPageSizes(PdfDocument)}, which gets all of them in one call.
      */
     public Size getPageSize(PdfDocument doc, int index) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             return nativeGetPageSizeByIndex(doc.mNativeDocPtr, index, mCurrentDpi);
         }
     }
 
+    /**
+     * Get geometry of all pages in one call, pages do not need to be opened.<br>
+     * Returns three values per page: width and height in points (0 if size cannot be read),
+     * and rotation in quarter turns clockwise, which is known only for opened pages and -1
+     * for the others. Sizes are computed once per document and then served from native cache.
+     */
+    public float[] getAllPageSizes(PdfDocument doc) {
+        synchronized (doc.mLock) {
+            return nativeGetAllPageSizes(doc.mNativeDocPtr);
+        }
+    }
+
     /**
      * Render page fragment on {@link Surface}.<br>
      * Page must be opened before rendering.
@@ -300,7 +608,7 @@ public class PdfiumCore {
     public void renderPage(PdfDocument doc, Surface surface, int pageIndex,
                            int startX, int startY, int drawSizeX, int drawSizeY,
                            boolean renderAnnot) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             try {
                 //nativeRenderPage(doc.mNativePagesPtr.get(pageIndex), surface, mCurrentDpi);
                 nativeRenderPage(doc.mNativePagesPtr.get(pageIndex), surface, mCurrentDpi,
@@ -322,7 +630,8 @@ public class PdfiumCore {
      * Supported bitmap configurations:
      * <ul>
      * <li>ARGB_8888 - best quality, high memory usage, higher possibility of OutOfMemoryError
-     * <li>RGB_565 - little worse quality, twice less memory usage
+     * <li>RGB_565 - little worse quality, twice less memory usage,
+     * see {@link PdfiumCore#setRgb565Dithering(boolean)}
      * </ul>
      */
     public void renderPageBitmap(PdfDocument doc, Bitmap bitmap, int pageIndex,
@@ -339,10 +648,11 @@ public class PdfiumCore {
     public void renderPageBitmap(PdfDocument doc, Bitmap bitmap, int pageIndex,
                                  int startX, int startY, int drawSizeX, int drawSizeY,
                                  boolean renderAnnot) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             try {
-                nativeRenderPageBitmap(doc.mNativePagesPtr.get(pageIndex), bitmap, mCurrentDpi,
-                        startX, startY, drawSizeX, drawSizeY, renderAnnot);
+                nativeRenderPageBitmap(doc.mNativeDocPtr, doc.mNativePagesPtr.get(pageIndex), pageIndex,
+                        bitmap, mCurrentDpi, startX, startY, drawSizeX, drawSizeY,
+                        renderAnnot, false, mDither565);
             } catch (NullPointerException e) {
                 Log.e(TAG, "mContext may be null");
                 e.printStackTrace();
@@ -362,10 +672,46 @@ public class PdfiumCore {
     public void renderPageBitmap(PdfDocument doc, Bitmap bitmap, int pageIndex,
         int startX, int startY, int drawSizeX, int drawSizeY,
         boolean renderAnnot, boolean renderForm) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
+            try {
+                nativeRenderPageBitmap(doc.mNativeDocPtr, doc.mNativePagesPtr.get(pageIndex), pageIndex,
+                    bitmap, mCurrentDpi, startX, startY, drawSizeX, drawSizeY,
+                    renderAnnot, renderForm, mDither565);
+            } catch (NullPointerException e) {
+                Log.e(TAG, "mContext may be null");
+                e.printStackTrace();
+            } catch (Exception e) {
+                Log.e(TAG, "Exception throw from native");
+                e.printStackTrace();
+            }
+        }
+    }
+
+    /**
+     * Render one tile of page on {@link Bitmap}.<br>
+     * Page scaled by zoom (pixels per PostScript point) is split into a grid of
+     * tileSize x tileSize tiles, tile at column tileX and row tileY is drawn into top left
+     * corner of bitmap. Memory usage depends only on tile size, so pages can be zoomed
+     * far beyond size of a whole-page bitmap.<br>
+     * Page must be opened before rendering.
+     */
+    public void renderPageTile(PdfDocument doc, Bitmap bitmap, int pageIndex, float zoom,
+                               int tileX, int tileY, int tileSize) {
+        renderPageTile(doc, bitmap, pageIndex, zoom, tileX, tileY, tileSize, false);
+    }
+
+    /**
+     * Render one tile of page on {@link Bitmap}. This method allows to render annotations.<br>
+     * Page must be opened before rendering.
+     * <p>
+     * For more info see {@link PdfiumCore#renderPageTile(PdfDocument, Bitmap, int, float, int, int, int)}
+     */
+    public void renderPageTile(PdfDocument doc, Bitmap bitmap, int pageIndex, float zoom,
+                               int tileX, int tileY, int tileSize, boolean renderAnnot) {
+        synchronized (doc.mLock) {
             try {
-                nativeRenderPageBitmap(doc.mNativeDocPtr, doc.mNativePagesPtr.get(pageIndex), bitmap, mCurrentDpi,
-                    startX, startY, drawSizeX, drawSizeY, renderAnnot);
+                nativeRenderPageTile(doc.mNativeDocPtr, doc.mNativePagesPtr.get(pageIndex), pageIndex, zoom,
+                        tileX, tileY, tileSize, bitmap, renderAnnot, false, mDither565);
             } catch (NullPointerException e) {
                 Log.e(TAG, "mContext may be null");
                 e.printStackTrace();
@@ -376,15 +722,327 @@ public class PdfiumCore {
         }
     }
 
-    /** Release native resources and opened file */
+    /**
+     * Render thumbnails of pages from given range into one bitmap, longer edge of every
+     * thumbnail is maxEdge pixels. Pages are measured without being loaded and each one
+     * is opened only for the time of its render, so pages do not have to be opened before.
+     * Atlas is about as high as wide and neither side exceeds {@link #MAX_THUMBNAIL_ATLAS_SIZE},
+     * so it stays within texture size limits. Pages which do not fit are left out:
+     * {@link ThumbnailAtlas#getToPage()} is the last page rendered, call again from the next one.
+     *
+     * @return atlas with thumbnails or null if bitmap could not be allocated
+     */
+    public ThumbnailAtlas renderThumbnails(PdfDocument doc, int fromPage, int toPage, int maxEdge) {
+        return renderThumbnails(doc, fromPage, toPage, maxEdge, false);
+    }
+
+    /**
+     * Render thumbnails of pages from given range into one bitmap. This method allows to render annotations.
+     * <br>
+     * For more info see {@link PdfiumCore#renderThumbnails(PdfDocument, int, int, int)}
+     */
+    public ThumbnailAtlas renderThumbnails(PdfDocument doc, int fromPage, int toPage, int maxEdge,
+                                           boolean renderAnnot) {
+        int[] layout;
+        synchronized (doc.mLock) {
+            layout = nativeLayoutThumbnails(doc.mNativeDocPtr, fromPage, toPage, maxEdge,
+                    MAX_THUMBNAIL_ATLAS_SIZE);
+        }
+        toPage = fromPage + (layout.length - 2) / 4 - 1;
+
+        Bitmap bitmap;
+        try {
+            bitmap = Bitmap.createBitmap(layout[0], Math.max(layout[1], 1), Bitmap.Config.ARGB_8888);
+        } catch (OutOfMemoryError e) {
+            Log.e(TAG, "Cannot allocate thumbnail atlas " + layout[0] + "x" + layout[1], e);
+            return null;
+        }
+
+        synchronized (doc.mLock) {
+            nativeRenderThumbnails(doc.mNativeDocPtr, fromPage, toPage, layout, bitmap, renderAnnot);
+        }
+        return new ThumbnailAtlas(bitmap, fromPage, toPage, layout);
+    }
+
+    /**
+     * Start progressive render of page fragment on {@link Bitmap}. At most budgetMillis
+     * is spent rendering before this method returns; if job is not finished by then, continue it
+     * with {@link PdfiumCore#continueRenderJob(RenderJob, long)} or drop it with
+     * {@link RenderJob#cancel()}. Forms are not rendered.<br>
+     * Fragments found in render or disk cache are copied and the job is done at once, finished
+     * renders are stored there, the same as by renderPageBitmap.<br>
+     * Page must be opened before rendering and stay open until job is finished.
+     * <p>
+     * For more info see {@link PdfiumCore#renderPageBitmap(PdfDocument, Bitmap, int, int, int, int, int)}
+     *
+     * @return job, or null if rendering could not be started
+     */
+    public RenderJob startRenderPageBitmap(PdfDocument doc, Bitmap bitmap, int pageIndex,
+                                           int startX, int startY, int drawSizeX, int drawSizeY,
+                                           boolean renderAnnot, long budgetMillis) {
+        synchronized (doc.mLock) {
+            Long pagePtr = doc.mNativePagesPtr.get(pageIndex);
+            if (pagePtr == null) {
+                return null;
+            }
+            long jobPtr = nativeRenderJobStart(doc.mNativeDocPtr, pagePtr, pageIndex, bitmap,
+                    startX, startY, drawSizeX, drawSizeY, renderAnnot, mDither565,
+                    budgetMillis * 1000000L);
+            if (jobPtr == 0) {
+                return null;
+            }
+
+            RenderJob job = new RenderJob(this, doc, pageIndex);
+            job.mNativeJobPtr = jobPtr;
+            doc.mRenderJobs.add(job);
+            updateRenderJob(job, nativeRenderJobGetStatus(jobPtr));
+            return job;
+        }
+    }
+
+    /**
+     * Continue paused render job for at most budgetMillis.
+     * Native resources of job are released as soon as it is finished.
+     *
+     * @return status of job, one of RenderJob.STATUS_* constants
+     */
+    public int continueRenderJob(RenderJob job, long budgetMillis) {
+        synchronized (job.document.mLock) {
+            if (job.isFinished()) {
+                return job.status;
+            }
+            updateRenderJob(job, nativeRenderJobResume(job.mNativeJobPtr, budgetMillis * 1000000L));
+            return job.status;
+        }
+    }
+
+    /** Release render job without finishing it. Bitmap content is undefined afterwards. */
+    public void closeRenderJob(RenderJob job) {
+        synchronized (job.document.mLock) {
+            if (!job.isFinished()) {
+                job.status = RenderJob.STATUS_CANCELLED;
+                releaseRenderJob(job);
+            }
+        }
+    }
+
+    /*package*/ void cancelRenderJob(RenderJob job) {
+        // Does not take the document lock, so it can stop a job being continued on other thread
+        synchronized (job) {
+            if (job.mNativeJobPtr != 0) {
+                nativeRenderJobCancel(job.mNativeJobPtr);
+            }
+        }
+    }
+
+    private void updateRenderJob(RenderJob job, int status) {
+        job.status = status;
+        if (job.isFinished()) {
+            releaseRenderJob(job);
+        }
+    }
+
+    private void releaseRenderJob(RenderJob job) {
+        synchronized (job) {
+            nativeRenderJobClose(job.mNativeJobPtr);
+            job.mNativeJobPtr = 0;
+        }
+        job.document.mRenderJobs.remove(job);
+    }
+
+    /**
+     * Get accumulated timing of bitmap rendering stages for given document.
+     * Useful to check how many full-frame conversion passes renders cost.
+     */
+    public PdfDocument.RenderStats getRenderStats(PdfDocument doc) {
+        long[] values = nativeGetRenderStats(doc.mNativeDocPtr);
+        PdfDocument.RenderStats stats = new PdfDocument.RenderStats();
+        stats.renderCount = values[0];
+        stats.formRenderCount = values[1];
+        stats.conversionPasses = values[2];
+        stats.cacheHits = values[3];
+        stats.cacheMisses = values[4];
+        stats.diskCacheHits = values[5];
+        stats.diskCacheMisses = values[6];
+        stats.formSkipCount = values[7];
+        stats.lockNanos = values[8];
+        stats.pageNanos = values[9];
+        stats.formNanos = values[10];
+        stats.convertNanos = values[11];
+        return stats;
+    }
+
+    /**
+     * Get counters of reads PDFium made from document data, whatever its source.
+     * Tells whether slow opens come from storage latency, scattered cross-reference
+     * layout or data read over and over.
+     */
+    public PdfDocument.IoStats getIoStats(PdfDocument doc) {
+        long[] values = nativeGetIoStats(doc.mNativeDocPtr);
+        PdfDocument.IoStats stats = new PdfDocument.IoStats();
+        stats.calls = values[0];
+        stats.bytes = values[1];
+        stats.failures = values[2];
+        stats.totalNanos = values[3];
+        stats.maxNanos = values[4];
+        int offset = 5;
+        System.arraycopy(values, offset, stats.latencyHistogram, 0, PdfDocument.IoStats.LATENCY_BUCKETS);
+        offset += PdfDocument.IoStats.LATENCY_BUCKETS;
+        System.arraycopy(values, offset, stats.offsetHeatmap, 0, PdfDocument.IoStats.OFFSET_BUCKETS);
+        return stats;
+    }
+
+    /**
+     * Set memory budget of native cache of rendered bitmaps and tiles. Rendering the same page
+     * fragment again with the same size and flags is then served by copying cached pixels.
+     * Least recently used entries are evicted to stay within budget.<br>
+     * Cache is shared by all documents in process, budget of 0 (default) disables it.
+     */
+    public void setRenderCacheSize(long bytes) {
+        nativeSetRenderCacheSize(bytes);
+    }
+
+    /** Get number of bytes currently used by native render cache */
+    public long getRenderCacheUsed() {
+        return nativeGetRenderCacheUsed();
+    }
+
+    /**
+     * Set size of the block cache between PDFium and file of every document opened afterwards
+     * from {@link ParcelFileDescriptor} or {@link DocumentSource}. Parser re-reads cross-reference
+     * tables and object streams in small pieces, cached blocks save a syscall or Java call for
+     * each of them. 0 disables the cache, default is 1MB.
+     */
+    public void setBlockCacheSize(long bytes) {
+        nativeSetBlockCacheSize(bytes);
+    }
+
+    /**
+     * Get counters of the process-wide lock serializing calls into PDFium. Contention here
+     * means threads working on different documents waited for each other.
+     */
+    public PdfDocument.LockStats getEngineLockStats() {
+        return toLockStats(nativeGetEngineLockStats());
+    }
+
+    /**
+     * Get counters of the native lock of document, shared by all handles of the same file.
+     * Contention here means threads working on this document waited for each other.
+     */
+    public PdfDocument.LockStats getDocumentLockStats(PdfDocument doc) {
+        return toLockStats(nativeGetDocumentLockStats(doc.mNativeDocPtr));
+    }
+
+    private static PdfDocument.LockStats toLockStats(long[] values) {
+        PdfDocument.LockStats stats = new PdfDocument.LockStats();
+        stats.acquisitions = values[0];
+        stats.contentions = values[1];
+        stats.waitNanos = values[2];
+        stats.maxWaitNanos = values[3];
+        return stats;
+    }
+
+    /** Get block cache counters of document, null if document was not opened from file or source */
+    public PdfDocument.BlockCacheStats getBlockCacheStats(PdfDocument doc) {
+        long[] values = nativeGetBlockCacheStats(doc.mNativeDocPtr);
+        if (values == null) {
+            return null;
+        }
+        PdfDocument.BlockCacheStats stats = new PdfDocument.BlockCacheStats();
+        stats.hits = values[0];
+        stats.misses = values[1];
+        stats.syscalls = values[2];
+        stats.bytesRead = values[3];
+        return stats;
+    }
+
+    /**
+     * Open persistent cache of rendered bitmaps, tiles and thumbnails in given directory,
+     * limited to maxBytes. Documents opened afterwards get a content fingerprint and their
+     * renders are stored in and served from it, so they survive closing the document and
+     * restarting the app. Cache is shared by all documents in process, directory can be used
+     * by one process at a time. Renders are written to disk on a background thread.
+     *
+     * @return false if cache could not be opened
+     */
+    public boolean openDiskCache(File dir, long maxBytes) {
+        return nativeOpenDiskCache(dir.getAbsolutePath(), maxBytes);
+    }
+
+    public void closeDiskCache() {
+        nativeCloseDiskCache();
+    }
+
+    /** Get number of bytes currently used by disk cache */
+    public long getDiskCacheUsed() {
+        return nativeGetDiskCacheUsed();
+    }
+
+    /**
+     * Get content fingerprint of a PDF file without loading it, it identifies the document in disk cache.
+     *
+     * @return fingerprint or 0 if file cannot be read
+     */
+    public long getFingerprint(ParcelFileDescriptor fd) {
+        return nativeGetFileFingerprint(getNumFd(fd));
+    }
+
+    /** Get fingerprint of document, 0 if disk cache was not open when it was loaded */
+    public long getFingerprint(PdfDocument doc) {
+        return nativeGetDocumentFingerprint(doc.mNativeDocPtr);
+    }
+
+    /**
+     * Get size in pixels of the most recently cached render of whole page, document does not
+     * have to be loaded. Use with {@link #renderCachedPageBitmap(long, Bitmap, int, int, int, int, int, boolean, boolean)}
+     * to show a page of an already viewed document before it is loaded.
+     *
+     * @return size or null if there is no cached render of whole page
+     */
+    public Size findCachedPageSize(long fingerprint, int pageIndex, boolean renderAnnot) {
+        int[] size = nativeFindCachedPage(fingerprint, pageIndex, renderAnnot);
+        return size == null ? null : new Size(size[0], size[1]);
+    }
+
+    /**
+     * Fill bitmap with page fragment stored in disk cache, without loading the document.
+     * Arguments have the same meaning as in {@link #renderPageBitmap(PdfDocument, Bitmap, int, int, int, int, int, boolean, boolean)}.
+     *
+     * @return false if fragment is not cached, bitmap is left untouched then
+     */
+    public boolean renderCachedPageBitmap(long fingerprint, Bitmap bitmap, int pageIndex,
+                                          int startX, int startY, int drawSizeX, int drawSizeY,
+                                          boolean renderAnnot, boolean renderForm) {
+        return nativeRenderCachedPageBitmap(fingerprint, pageIndex, bitmap, startX, startY,
+                drawSizeX, drawSizeY, renderAnnot, renderForm, mDither565);
+    }
+
+    /**
+     * Set how many documents opened from files are kept parsed after their last handle
+     * was closed, so that reopening them is instant. Default is 1, 0 disables retaining.
+     */
+    public void setRetainedDocumentCount(int count) {
+        nativeSetRetainedDocuments(count);
+    }
+
+    /** Release native resources and opened file. Closing a document again does nothing. */
     public void closeDocument(PdfDocument doc) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
+            if (doc.mNativeDocPtr == 0) {
+                return;
+            }
+            for (RenderJob job : new ArrayList<>(doc.mRenderJobs)) {
+                closeRenderJob(job);
+            }
+
             for (Integer index : doc.mNativePagesPtr.keySet()) {
-                nativeClosePage(doc.mNativePagesPtr.get(index));
+                nativeClosePage(doc.mNativeDocPtr, doc.mNativePagesPtr.get(index));
             }
             doc.mNativePagesPtr.clear();
 
             nativeCloseDocument(doc.mNativeDocPtr);
+            doc.mNativeDocPtr = 0;
+            doc.mDirectBuffer = null;
 
             if (doc.parcelFileDescriptor != null) { //if document was loaded from file
                 try {
@@ -399,7 +1057,7 @@ public class PdfiumCore {
 
     /** Get metadata for given document */
     public PdfDocument.Meta getDocumentMeta(PdfDocument doc) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             PdfDocument.Meta meta = new PdfDocument.Meta();
             meta.title = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Title");
             meta.author = nativeGetDocumentMetaText(doc.mNativeDocPtr, "Author");
@@ -414,54 +1072,64 @@ public class PdfiumCore {
         }
     }
 
-    /** Get table of contents (bookmarks) for given document */
+    /**
+     * Get table of contents (bookmarks) for given document. The whole outline is read in one
+     * native call; bookmarks reached twice through a malformed outline are left out.
+     */
     public List<PdfDocument.Bookmark> getTableOfContents(PdfDocument doc) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             List<PdfDocument.Bookmark> topLevel = new ArrayList<>();
-            Long first = nativeGetFirstChildBookmark(doc.mNativeDocPtr, null);
-            if (first != null) {
-                recursiveGetBookmark(topLevel, doc, first);
+            Object[] outline = nativeGetOutline(doc.mNativeDocPtr);
+            int[] parents = (int[]) outline[0];
+            int[] depths = (int[]) outline[1];
+            int[] pages = (int[]) outline[2];
+            long[] bookmarkPtrs = (long[]) outline[3];
+            int[] titleOffsets = (int[]) outline[4];
+            char[] titles = (char[]) outline[5];
+
+            //Parents precede their children
+            PdfDocument.Bookmark[] bookmarks = new PdfDocument.Bookmark[parents.length];
+            for (int i = 0; i < parents.length; i++) {
+                PdfDocument.Bookmark bookmark = new PdfDocument.Bookmark();
+                bookmark.mNativePtr = bookmarkPtrs[i];
+                bookmark.title = new String(titles, titleOffsets[i], titleOffsets[i + 1] - titleOffsets[i]);
+                bookmark.pageIdx = pages[i];
+                bookmark.depth = depths[i];
+                bookmarks[i] = bookmark;
+                if (parents[i] < 0) {
+                    topLevel.add(bookmark);
+                } else {
+                    bookmarks[parents[i]].getChildren().add(bookmark);
+                }
             }
             return topLevel;
         }
     }
 
-    private void recursiveGetBookmark(List<PdfDocument.Bookmark> tree, PdfDocument doc, long bookmarkPtr) {
-        PdfDocument.Bookmark bookmark = new PdfDocument.Bookmark();
-        bookmark.mNativePtr = bookmarkPtr;
-        bookmark.title = nativeGetBookmarkTitle(bookmarkPtr);
-        bookmark.pageIdx = nativeGetBookmarkDestIndex(doc.mNativeDocPtr, bookmarkPtr);
-        tree.add(bookmark);
-
-        Long child = nativeGetFirstChildBookmark(doc.mNativeDocPtr, bookmarkPtr);
-        if (child != null) {
-            recursiveGetBookmark(bookmark.getChildren(), doc, child);
-        }
-
-        Long sibling = nativeGetSiblingBookmark(doc.mNativeDocPtr, bookmarkPtr);
-        if (sibling != null) {
-            recursiveGetBookmark(tree, doc, sibling);
-        }
-    }
-
-    /** Get all links from given page */
+    /**
+     * Get all links from given page. Links are extracted in one native call when first asked
+     * for and kept until the page is closed.
+     */
     public List<PdfDocument.Link> getPageLinks(PdfDocument doc, int pageIndex) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             List<PdfDocument.Link> links = new ArrayList<>();
             Long nativePagePtr = doc.mNativePagesPtr.get(pageIndex);
             if (nativePagePtr == null) {
                 return links;
             }
-            long[] linkPtrs = nativeGetPageLinks(nativePagePtr);
-            for (long linkPtr : linkPtrs) {
-                Integer index = nativeGetDestPageIndex(doc.mNativeDocPtr, linkPtr);
-                String uri = nativeGetLinkURI(doc.mNativeDocPtr, linkPtr);
-
-                RectF rect = nativeGetLinkRect(linkPtr);
-                if (rect != null && (index != null || uri != null)) {
-                    links.add(new PdfDocument.Link(rect, index, uri));
-                }
-
+            Object[] table = nativeGetPageLinkTable(doc.mNativeDocPtr, nativePagePtr);
+            float[] rects = (float[]) table[0];
+            int[] info = (int[]) table[1];
+            float[] quads = (float[]) table[2];
+            String[] uris = (String[]) table[3];
+            for (int i = 0; i < info.length / 4; i++) {
+                RectF bounds = new RectF(rects[4 * i], rects[4 * i + 1],
+                        rects[4 * i + 2], rects[4 * i + 3]);
+                Integer destPageIdx = info[4 * i] >= 0 ? info[4 * i] : null;
+                String uri = info[4 * i + 1] >= 0 ? uris[info[4 * i + 1]] : null;
+                int quadStart = info[4 * i + 2] * 8;
+                float[] quadPoints = Arrays.copyOfRange(quads, quadStart, quadStart + info[4 * i + 3] * 8);
+                links.add(new PdfDocument.Link(bounds, destPageIdx, uri, quadPoints));
             }
             return links;
         }
@@ -538,7 +1206,7 @@ public class PdfiumCore {
     }
 
     public long openTextPage(PdfDocument doc, int pageIndex) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             long page = openPage(doc, pageIndex);
             Long textPagePtr = doc.mNativeTextPagesPtr.get(pageIndex);
             if (textPagePtr == null) {
@@ -551,7 +1219,7 @@ public class PdfiumCore {
     }
 
     public void closeTextPage(PdfDocument doc, int pageIndex) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             final Long nativeLoadTextPage = doc.mNativeTextPagesPtr.get(pageIndex);
             if (nativeLoadTextPage != null) {
                 nativeCloseTextPage(nativeLoadTextPage);
@@ -562,7 +1230,7 @@ public class PdfiumCore {
 
     public long[] openTextPage(PdfDocument doc, int fromIndex, int toIndex) {
         long[] textPagesPtr;
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             textPagesPtr = nativeLoadPages(doc.mNativeDocPtr, fromIndex, toIndex);
             int pageIndex = fromIndex;
             for (long page : textPagesPtr) {
@@ -576,7 +1244,7 @@ public class PdfiumCore {
     }
 
     public int textPageCountChars(PdfDocument doc, int textPageIndex) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             try {
                 return nativeTextCountChars(doc.mNativeTextPagesPtr.get(textPageIndex));
             } catch (NullPointerException e) {
@@ -591,7 +1259,7 @@ public class PdfiumCore {
     }
 
     public String textPageGetText(PdfDocument doc, int textPageIndex, int startIndex, int length) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             try {
                 short[] buf = new short[length+1];
 
@@ -627,7 +1295,7 @@ public class PdfiumCore {
 
 
     public char textPageGetUnicode(PdfDocument doc, int textPageIndex, int index) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             try {
                 return (char)nativeTextGetUnicode(doc.mNativeTextPagesPtr.get(textPageIndex), index);
             } catch (NullPointerException e) {
@@ -642,7 +1310,7 @@ public class PdfiumCore {
     }
 
     public RectF textPageGetCharBox(PdfDocument doc, int textPageIndex, int index) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             try {
                 double[] o = nativeTextGetCharBox(doc.mNativeTextPagesPtr.get(textPageIndex), index);
                 RectF r = new RectF();
@@ -662,8 +1330,38 @@ public class PdfiumCore {
         return null;
     }
 
+    /**
+     * Extract text, character boxes and optionally font sizes of whole opened text page into
+     * direct buffers, in one native call. Buffers are written from their start in native byte
+     * order: UTF-16 char per character in text, four floats [left, top, right, bottom] in page
+     * coordinates per character in boxes, one float per character in fontSizes, which can be null.
+     * @return number of characters on page; if it does not fit the buffers nothing is written
+     */
+    public int textPageExtract(PdfDocument doc, int textPageIndex, ByteBuffer text, ByteBuffer boxes,
+                               ByteBuffer fontSizes) {
+        synchronized (doc.mLock) {
+            return nativeTextExtract(doc.mNativeTextPagesPtr.get(textPageIndex), text, boxes, fontSizes);
+        }
+    }
+
+    /** Extract whole opened text page into given {@link PageText}, which is returned */
+    public PageText textPageExtract(PdfDocument doc, int textPageIndex, PageText pageText) {
+        synchronized (doc.mLock) {
+            long textPagePtr = doc.mNativeTextPagesPtr.get(textPageIndex);
+            int count = nativeTextExtract(textPagePtr, pageText.getTextBytes(), pageText.getBoxBytes(),
+                    pageText.getFontSizeBytes());
+            if (count > pageText.getTextBytes().capacity() / 2) {
+                pageText.ensureCapacity(count);
+                count = nativeTextExtract(textPagePtr, pageText.getTextBytes(), pageText.getBoxBytes(),
+                        pageText.getFontSizeBytes());
+            }
+            pageText.setCharCount(Math.max(count, 0));
+            return pageText;
+        }
+    }
+
     public int textPageGetCharIndexAtPos(PdfDocument doc, int textPageIndex, double x, double y, double xTolerance, double yTolerance) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             try {
                 return nativeTextGetCharIndexAtPos(doc.mNativeTextPagesPtr.get(textPageIndex), x, y, xTolerance, yTolerance);
             } catch (NullPointerException e) {
@@ -678,7 +1376,7 @@ public class PdfiumCore {
     }
 
     public int textPageCountRects(PdfDocument doc, int textPageIndex, int start_index, int count) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             try {
                 return nativeTextCountRects(doc.mNativeTextPagesPtr.get(textPageIndex), start_index, count);
             } catch (NullPointerException e) {
@@ -693,7 +1391,7 @@ public class PdfiumCore {
     }
 
     public RectF textPageGetRect(PdfDocument doc, int textPageIndex, int rect_index) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             try {
                 double[] o = nativeTextGetRect(doc.mNativeTextPagesPtr.get(textPageIndex), rect_index);
                 RectF r = new RectF();
@@ -714,7 +1412,7 @@ public class PdfiumCore {
     }
 
     public String textPageGetBoundedText(PdfDocument doc, int textPageIndex, RectF rect, int length) {
-        synchronized (lock) {
+        synchronized (doc.mLock) {
             try {
                 short[] buf = new short[length+1];
 
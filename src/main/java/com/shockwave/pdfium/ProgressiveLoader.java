@@ -0,0 +1,96 @@
+package com.shockwave.pdfium;
+
+import java.io.IOException;
+
+/**
+ * Drives progressive loading of a document whose bytes are fetched in ranges, e.g. with
+ * HTTP range requests. Only ranges the parser asks for are fetched, so for linearized
+ * documents the first page can be rendered long before the whole file has arrived.
+ * <p>
+ * Methods block while fetching and should be called from a background thread.
+ */
+public class ProgressiveLoader {
+    /** Largest range fetched at once, bigger requests are split */
+    private static final int MAX_FETCH_SIZE = 64 * 1024;
+
+    private final PdfiumCore core;
+    private final DocumentSource source;
+    private final byte[] buffer = new byte[MAX_FETCH_SIZE];
+    private long fileSize;
+    //Fallback when the parser waits for data without asking for a range
+    private long sequentialOffset = 0;
+
+    public ProgressiveLoader(PdfiumCore core, DocumentSource source) {
+        this.core = core;
+        this.source = source;
+    }
+
+    /** Fetch data until document can be opened */
+    public PdfDocument open(String password) throws IOException {
+        fileSize = source.getSize();
+        PdfDocument doc = core.newProgressiveDocument(fileSize);
+        boolean opened = false;
+        try {
+            int status;
+            while ((status = core.loadProgressiveDocument(doc, password)) != PdfiumCore.DATA_AVAILABLE) {
+                if (status == PdfiumCore.DATA_ERROR) {
+                    throw new IOException("Document data is corrupted");
+                }
+                fetchRequested(doc);
+            }
+            opened = true;
+        } finally {
+            if (!opened) {
+                core.closeDocument(doc);
+            }
+        }
+        return doc;
+    }
+
+    /** Fetch data until given page of opened document can be loaded */
+    public void loadPage(PdfDocument doc, int pageIndex) throws IOException {
+        int status;
+        while ((status = core.isPageAvailable(doc, pageIndex)) != PdfiumCore.DATA_AVAILABLE) {
+            if (status == PdfiumCore.DATA_ERROR) {
+                throw new IOException("Data of page " + pageIndex + " is corrupted");
+            }
+            fetchRequested(doc);
+        }
+    }
+
+    private void fetchRequested(PdfDocument doc) throws IOException {
+        long[] ranges = core.getRequestedRanges(doc);
+        if (ranges.length == 0) {
+            fetchNext(doc);
+            return;
+        }
+        for (int i = 0; i + 1 < ranges.length; i += 2) {
+            fetch(doc, ranges[i], ranges[i + 1]);
+        }
+    }
+
+    private void fetchNext(PdfDocument doc) throws IOException {
+        if (sequentialOffset >= fileSize) {
+            throw new IOException("Document is incomplete after reading whole file");
+        }
+        long size = Math.min(MAX_FETCH_SIZE, fileSize - sequentialOffset);
+        fetch(doc, sequentialOffset, size);
+        sequentialOffset += size;
+    }
+
+    private void fetch(PdfDocument doc, long offset, long size) throws IOException {
+        while (size > 0) {
+            int length = (int) Math.min(size, MAX_FETCH_SIZE);
+            for (int done = 0; done < length; ) {
+                int read = source.read(offset + done, buffer, done, length - done);
+                if (read < 0) {
+                    throw new IOException("Unexpected end of data at " + (offset + done));
+                }
+                done += read;
+            }
+            core.addDocumentData(doc, offset, buffer, 0, length);
+            offset += length;
+            size -= length;
+        }
+    }
+}
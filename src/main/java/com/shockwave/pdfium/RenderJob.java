@@ -0,0 +1,49 @@
+package com.shockwave.pdfium;
+
+/**
+ * Progressive render of a page fragment, created by
+ * {@link PdfiumCore#startRenderPageBitmap(PdfDocument, android.graphics.Bitmap, int, int, int, int, int, boolean, long)}.
+ * <p>
+ * Rendering is done in slices limited by a time budget, so job may be left paused, resumed
+ * later with {@link PdfiumCore#continueRenderJob(RenderJob, long)} or cancelled from any thread.
+ * Bitmap must not be used until job is done.
+ */
+public class RenderJob {
+    public static final int STATUS_PAUSED = 1;
+    public static final int STATUS_DONE = 2;
+    public static final int STATUS_FAILED = 3;
+    public static final int STATUS_CANCELLED = 4;
+
+    private final PdfiumCore core;
+    /*package*/ final PdfDocument document;
+    /*package*/ final int pageIndex;
+    /*package*/ long mNativeJobPtr;
+    /*package*/ volatile int status = STATUS_PAUSED;
+
+    /*package*/ RenderJob(PdfiumCore core, PdfDocument document, int pageIndex) {
+        this.core = core;
+        this.document = document;
+        this.pageIndex = pageIndex;
+    }
+
+    public int getPageIndex() {
+        return pageIndex;
+    }
+
+    public int getStatus() {
+        return status;
+    }
+
+    /** Job is done, failed or cancelled and its native resources are released */
+    public boolean isFinished() {
+        return status != STATUS_PAUSED;
+    }
+
+    /**
+     * Stop rendering as soon as possible. Can be called from any thread, also while
+     * job is being continued on another one.
+     */
+    public void cancel() {
+        core.cancelRenderJob(this);
+    }
+}
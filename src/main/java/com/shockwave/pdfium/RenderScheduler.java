@@ -0,0 +1,350 @@
+package com.shockwave.pdfium;
+
+import android.util.Log;
+
+import java.util.ArrayList;
+import java.util.Comparator;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.PriorityQueue;
+
+/**
+ * Runs render requests on background threads, most important first.
+ * <p>
+ * Requests are ordered by priority ({@link #PRIORITY_VISIBLE} before {@link #PRIORITY_ADJACENT}
+ * before {@link #PRIORITY_PREFETCH}) and then by submission. Requests with equal keys are
+ * assumed to do the same work: submitting one while an equal one is queued or running only
+ * raises priority of that one. Requests which went stale while queued are dropped without
+ * running, and running ones stop their {@link RenderJob} once stale or cancelled.
+ */
+public class RenderScheduler {
+    private static final String TAG = RenderScheduler.class.getName();
+
+    public static final int PRIORITY_VISIBLE = 0;
+    public static final int PRIORITY_ADJACENT = 1;
+    public static final int PRIORITY_PREFETCH = 2;
+    /*package*/ static final int PRIORITY_COUNT = 3;
+
+    /** Time slice of render jobs, staleness and cancellation are checked in between */
+    public static final long RENDER_SLICE_MILLIS = 8;
+
+    public abstract static class Request {
+        private final Object key;
+        //Priority, sequence and queue time are changed under the scheduler lock
+        private volatile int priority;
+        private long sequence;
+        private long queuedNanos;
+        private volatile boolean cancelled;
+        private volatile RenderScheduler scheduler;
+        private RenderJob renderJob; //guarded by this
+
+        /** Key must implement equals and hashCode, equal keys mean the same work */
+        protected Request(Object key, int priority) {
+            if (priority < PRIORITY_VISIBLE || priority >= PRIORITY_COUNT) {
+                throw new IllegalArgumentException("Unknown priority " + priority);
+            }
+            this.key = key;
+            this.priority = priority;
+        }
+
+        public Object getKey() {
+            return key;
+        }
+
+        public int getPriority() {
+            return priority;
+        }
+
+        public boolean isCancelled() {
+            return cancelled;
+        }
+
+        /** Do the work, called on a scheduler thread */
+        protected abstract void run();
+
+        /**
+         * Whether result is no longer needed. Checked before request runs and between slices
+         * of its render job; should be cheap and may be called on any thread.
+         */
+        protected boolean isStale() {
+            return false;
+        }
+
+        /** Called instead of {@link #run()} when request is dropped as stale or cancelled before running */
+        protected void onDropped() {
+        }
+
+        /** Drop request if queued, or stop its render job if running */
+        public void cancel() {
+            cancelled = true;
+            synchronized (this) {
+                if (renderJob != null) {
+                    renderJob.cancel();
+                }
+            }
+            RenderScheduler owner = scheduler;
+            if (owner != null) {
+                owner.dequeue(this);
+            }
+        }
+
+        /**
+         * Continue render job in slices until it is finished, cancelling it if request is
+         * cancelled or goes stale meanwhile. To be called from {@link #run()}.
+         *
+         * @return true if job is done
+         */
+        protected boolean completeRenderJob(PdfiumCore core, RenderJob job) {
+            synchronized (this) {
+                renderJob = job;
+            }
+            try {
+                while (!job.isFinished()) {
+                    if (cancelled || isStale()) {
+                        core.closeRenderJob(job);
+                        break;
+                    }
+                    core.continueRenderJob(job, RENDER_SLICE_MILLIS);
+                }
+            } finally {
+                synchronized (this) {
+                    renderJob = null;
+                }
+            }
+            return job.getStatus() == RenderJob.STATUS_DONE;
+        }
+    }
+
+    public static class Stats {
+        int queueDepth;
+        int maxQueueDepth;
+        long submitted;
+        long coalesced;
+        long dropped;
+        long completed;
+        final long[] runCount = new long[PRIORITY_COUNT];
+        final long[] waitNanos = new long[PRIORITY_COUNT];
+        final long[] maxWaitNanos = new long[PRIORITY_COUNT];
+
+        /** Requests waiting to run now */
+        public int getQueueDepth() {
+            return queueDepth;
+        }
+
+        public int getMaxQueueDepth() {
+            return maxQueueDepth;
+        }
+
+        public long getSubmitted() {
+            return submitted;
+        }
+
+        /** Submissions served by an equal request already queued or running */
+        public long getCoalesced() {
+            return coalesced;
+        }
+
+        /** Requests dropped without running, as stale or cancelled */
+        public long getDropped() {
+            return dropped;
+        }
+
+        public long getCompleted() {
+            return completed;
+        }
+
+        /** Requests of given priority taken from queue */
+        public long getRunCount(int priority) {
+            return runCount[priority];
+        }
+
+        /** Total time requests of given priority waited in queue */
+        public long getWaitNanos(int priority) {
+            return waitNanos[priority];
+        }
+
+        public long getMaxWaitNanos(int priority) {
+            return maxWaitNanos[priority];
+        }
+    }
+
+    private final PriorityQueue<Request> queue = new PriorityQueue<>(16, new Comparator<Request>() {
+        @Override
+        public int compare(Request a, Request b) {
+            if (a.priority != b.priority) {
+                return a.priority < b.priority ? -1 : 1;
+            }
+            return a.sequence < b.sequence ? -1 : (a.sequence == b.sequence ? 0 : 1);
+        }
+    });
+    //Queued and running requests by key
+    private final Map<Object, Request> requests = new HashMap<>();
+    private final List<Request> running = new ArrayList<>();
+    private final Thread[] threads;
+    private final Stats stats = new Stats();
+    private long nextSequence = 0;
+    private boolean shutdown = false;
+
+    public RenderScheduler(int threadCount) {
+        threads = new Thread[threadCount];
+        for (int i = 0; i < threadCount; i++) {
+            threads[i] = new Thread(new Runnable() {
+                @Override
+                public void run() {
+                    loop();
+                }
+            }, "PdfiumRender-" + i);
+            threads[i].setDaemon(true);
+            threads[i].start();
+        }
+    }
+
+    /**
+     * Queue request. If an equal request is already queued or running, that one is returned
+     * instead and given request is not used. After {@link #shutdown()} requests are dropped.
+     */
+    public Request submit(Request request) {
+        synchronized (this) {
+            stats.submitted++;
+            if (shutdown) {
+                stats.dropped++;
+            } else {
+                return enqueue(request);
+            }
+        }
+        request.onDropped();
+        return request;
+    }
+
+    //Called under scheduler lock
+    private Request enqueue(Request request) {
+        Request existing = requests.get(request.key);
+        if (existing != null && !existing.cancelled) {
+            stats.coalesced++;
+            if (request.priority < existing.priority && queue.remove(existing)) {
+                existing.priority = request.priority;
+                queue.add(existing);
+            }
+            return existing;
+        }
+
+        request.scheduler = this;
+        request.sequence = nextSequence++;
+        request.queuedNanos = System.nanoTime();
+        queue.add(request);
+        requests.put(request.key, request);
+        stats.maxQueueDepth = Math.max(stats.maxQueueDepth, queue.size());
+        notify();
+        return request;
+    }
+
+    /** Drop all queued requests and cancel running ones */
+    public void cancelAll() {
+        List<Request> cancelled;
+        synchronized (this) {
+            cancelled = new ArrayList<>(queue);
+            cancelled.addAll(running);
+        }
+        for (Request request : cancelled) {
+            request.cancel();
+        }
+    }
+
+    /** Cancel everything and stop threads, waiting for running requests to return */
+    public void shutdown() {
+        synchronized (this) {
+            shutdown = true;
+            notifyAll();
+        }
+        cancelAll();
+        boolean interrupted = false;
+        for (Thread thread : threads) {
+            while (thread.isAlive()) {
+                try {
+                    thread.join();
+                } catch (InterruptedException e) {
+                    interrupted = true;
+                }
+            }
+        }
+        if (interrupted) {
+            Thread.currentThread().interrupt();
+        }
+    }
+
+    public synchronized Stats getStats() {
+        Stats copy = new Stats();
+        copy.queueDepth = queue.size();
+        copy.maxQueueDepth = stats.maxQueueDepth;
+        copy.submitted = stats.submitted;
+        copy.coalesced = stats.coalesced;
+        copy.dropped = stats.dropped;
+        copy.completed = stats.completed;
+        System.arraycopy(stats.runCount, 0, copy.runCount, 0, PRIORITY_COUNT);
+        System.arraycopy(stats.waitNanos, 0, copy.waitNanos, 0, PRIORITY_COUNT);
+        System.arraycopy(stats.maxWaitNanos, 0, copy.maxWaitNanos, 0, PRIORITY_COUNT);
+        return copy;
+    }
+
+    private void dequeue(Request request) {
+        synchronized (this) {
+            if (!queue.remove(request)) {
+                return;
+            }
+            requests.remove(request.key);
+            stats.dropped++;
+        }
+        request.onDropped();
+    }
+
+    private void loop() {
+        while (true) {
+            Request request;
+            synchronized (this) {
+                while (queue.isEmpty() && !shutdown) {
+                    try {
+                        wait();
+                    } catch (InterruptedException e) {
+                        /* keep waiting until shut down */
+                    }
+                }
+                if (shutdown) {
+                    return;
+                }
+                request = queue.poll();
+                running.add(request);
+                long waited = System.nanoTime() - request.queuedNanos;
+                int priority = request.priority;
+                stats.runCount[priority]++;
+                stats.waitNanos[priority] += waited;
+                stats.maxWaitNanos[priority] = Math.max(stats.maxWaitNanos[priority], waited);
+            }
+
+            boolean ran = false;
+            try {
+                if (!request.cancelled && !request.isStale()) {
+                    ran = true;
+                    request.run();
+                }
+            } catch (RuntimeException e) {
+                Log.e(TAG, "Render request failed", e);
+            } finally {
+                synchronized (this) {
+                    running.remove(request);
+                    if (requests.get(request.key) == request) {
+                        requests.remove(request.key);
+                    }
+                    if (ran) {
+                        stats.completed++;
+                    } else {
+                        stats.dropped++;
+                    }
+                }
+            }
+            if (!ran) {
+                request.onDropped();
+            }
+        }
+    }
+}
@@ -0,0 +1,223 @@
+package com.shockwave.pdfium;
+
+import android.content.ComponentName;
+import android.content.Context;
+import android.content.Intent;
+import android.content.ServiceConnection;
+import android.graphics.Bitmap;
+import android.os.IBinder;
+import android.os.ParcelFileDescriptor;
+import android.os.RemoteException;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.BlockingQueue;
+import java.util.concurrent.Callable;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.concurrent.TimeUnit;
+
+/**
+ * Renders pages of one document in parallel in several worker processes.
+ * <p>
+ * PDFium is not thread-safe, so one process renders one page at a time whatever the number of
+ * threads. Each worker here is a {@link RenderWorkerService} in its own process which opens the
+ * document itself and renders into shared memory mapped by this process, so batch thumbnailing
+ * or export scale with cores. Pages are placed on whichever worker is idle.
+ * <p>
+ * Workers start asynchronously and their connections are delivered on the main thread, so
+ * results must not be waited for on the main thread. A worker which died is restarted by the
+ * system, the document is then opened in it again on its next render.
+ */
+public class RenderWorkerPool {
+    private static final long CONNECT_TIMEOUT_MILLIS = 10000;
+
+    private final Context context;
+    private final PdfiumCore core;
+    private final ParcelFileDescriptor fd;
+    private final String password;
+    private final Worker[] workers;
+    private final BlockingQueue<Worker> idleWorkers;
+    private final ExecutorService executor;
+
+    /**
+     * Start workers rendering given document. Descriptor stays owned by caller and must stay
+     * open until pool is closed.
+     *
+     * @param workerCount number of worker processes, at most {@link RenderWorkerService#MAX_WORKERS}
+     */
+    public RenderWorkerPool(Context context, PdfiumCore core, ParcelFileDescriptor fd, String password,
+                            int workerCount) {
+        if (workerCount < 1 || workerCount > RenderWorkerService.MAX_WORKERS) {
+            throw new IllegalArgumentException("Worker count must be from 1 to " + RenderWorkerService.MAX_WORKERS);
+        }
+        this.context = context.getApplicationContext();
+        this.core = core;
+        this.fd = fd;
+        this.password = password;
+        workers = new Worker[workerCount];
+        idleWorkers = new ArrayBlockingQueue<>(workerCount);
+        for (int i = 0; i < workerCount; i++) {
+            workers[i] = new Worker(i);
+            workers[i].bind();
+            idleWorkers.add(workers[i]);
+        }
+        executor = Executors.newFixedThreadPool(workerCount);
+    }
+
+    /**
+     * Render whole page scaled to width x height into new ARGB_8888 bitmap on first idle worker.
+     * Future fails with {@link IOException} if document cannot be opened or worker died.
+     */
+    public Future<Bitmap> renderPage(final int pageIndex, final int width, final int height,
+                                     final boolean renderAnnot) {
+        return executor.submit(new Callable<Bitmap>() {
+            @Override
+            public Bitmap call() throws Exception {
+                Worker worker = idleWorkers.take();
+                try {
+                    return worker.render(pageIndex, width, height, renderAnnot);
+                } finally {
+                    idleWorkers.add(worker);
+                }
+            }
+        });
+    }
+
+    /** Stop workers, pending renders are cancelled. Descriptor of document is not closed. */
+    public void close() {
+        executor.shutdownNow();
+        try {
+            executor.awaitTermination(CONNECT_TIMEOUT_MILLIS, TimeUnit.MILLISECONDS);
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+        }
+        for (Worker worker : workers) {
+            worker.release();
+        }
+    }
+
+    private class Worker implements ServiceConnection {
+        private final int index;
+        private IRenderWorker service;
+        private volatile boolean documentOpened;
+        private ParcelFileDescriptor pixelsFd;
+        private ByteBuffer pixels;
+        private volatile boolean pixelsSent;
+
+        Worker(int index) {
+            this.index = index;
+        }
+
+        void bind() {
+            Intent intent = new Intent(context, RenderWorkerService.workerClass(index));
+            context.bindService(intent, this, Context.BIND_AUTO_CREATE);
+        }
+
+        Bitmap render(int pageIndex, int width, int height, boolean renderAnnot)
+                throws IOException, InterruptedException {
+            IRenderWorker remote = awaitService();
+            int size = width * height * 4;
+            try {
+                if (!documentOpened) {
+                    int result = remote.openDocument(fd, password);
+                    if (result == RenderWorkerService.ERROR_PASSWORD) {
+                        throw new PdfPasswordException("Password required or incorrect password.");
+                    } else if (result < 0) {
+                        throw new IOException("Worker " + index + " cannot open document");
+                    }
+                    documentOpened = true;
+                }
+                if (pixels == null || pixels.capacity() < size) {
+                    releasePixels();
+                    pixelsFd = core.createSharedMemory(size);
+                    pixels = pixelsFd != null ? core.mapSharedMemory(pixelsFd, size) : null;
+                    if (pixels == null) {
+                        releasePixels();
+                        throw new IOException("Cannot allocate " + size + " bytes of shared memory");
+                    }
+                }
+                if (!pixelsSent) {
+                    if (!remote.setPixelBuffer(pixelsFd, pixels.capacity())) {
+                        throw new IOException("Worker " + index + " cannot map shared memory");
+                    }
+                    pixelsSent = true;
+                }
+                if (!remote.renderPage(pageIndex, width, height, renderAnnot)) {
+                    throw new IOException("Worker " + index + " cannot render page " + pageIndex);
+                }
+            } catch (RemoteException e) {
+                //Process died, restarted worker starts from scratch
+                documentOpened = false;
+                pixelsSent = false;
+                throw new IOException("Worker " + index + " died", e);
+            }
+
+            Bitmap bitmap = Bitmap.createBitmap(width, height, Bitmap.Config.ARGB_8888);
+            pixels.clear();
+            pixels.limit(size);
+            bitmap.copyPixelsFromBuffer(pixels);
+            return bitmap;
+        }
+
+        private synchronized IRenderWorker awaitService() throws IOException, InterruptedException {
+            long deadline = System.currentTimeMillis() + CONNECT_TIMEOUT_MILLIS;
+            while (service == null) {
+                long left = deadline - System.currentTimeMillis();
+                if (left <= 0) {
+                    throw new IOException("Worker " + index + " did not start");
+                }
+                wait(left);
+            }
+            return service;
+        }
+
+        @Override
+        public synchronized void onServiceConnected(ComponentName name, IBinder binder) {
+            service = IRenderWorker.Stub.asInterface(binder);
+            documentOpened = false;
+            pixelsSent = false;
+            notifyAll();
+        }
+
+        @Override
+        public synchronized void onServiceDisconnected(ComponentName name) {
+            service = null;
+        }
+
+        void release() {
+            IRenderWorker remote;
+            synchronized (this) {
+                remote = service;
+                service = null;
+            }
+            if (remote != null) {
+                try {
+                    remote.close();
+                } catch (RemoteException e) {
+                    /* ignore */
+                }
+            }
+            context.unbindService(this);
+            releasePixels();
+        }
+
+        private void releasePixels() {
+            if (pixels != null) {
+                core.unmapSharedMemory(pixels);
+                pixels = null;
+            }
+            if (pixelsFd != null) {
+                try {
+                    pixelsFd.close();
+                } catch (IOException e) {
+                    /* ignore */
+                }
+                pixelsFd = null;
+            }
+            pixelsSent = false;
+        }
+    }
+}
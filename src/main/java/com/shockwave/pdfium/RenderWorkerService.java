@@ -0,0 +1,153 @@
+package com.shockwave.pdfium;
+
+import android.app.Service;
+import android.content.Intent;
+import android.os.IBinder;
+import android.os.ParcelFileDescriptor;
+import android.util.Log;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+/**
+ * Renders pages in a separate process, see {@link RenderWorkerPool}. Every worker is its own
+ * service class declared with its own android:process, so that each has a PDFium of its own.
+ * Worker opens the document itself from the descriptor it is given and writes pixels into
+ * shared memory mapped by the caller, no pixels go through binder.
+ */
+public class RenderWorkerService extends Service {
+    private static final String TAG = RenderWorkerService.class.getName();
+
+    /** Number of worker services declared in manifest */
+    public static final int MAX_WORKERS = 4;
+
+    public static final int ERROR_IO = -1;
+    public static final int ERROR_PASSWORD = -2;
+
+    public static class Worker0 extends RenderWorkerService {
+    }
+
+    public static class Worker1 extends RenderWorkerService {
+    }
+
+    public static class Worker2 extends RenderWorkerService {
+    }
+
+    public static class Worker3 extends RenderWorkerService {
+    }
+
+    /*package*/ static Class<? extends RenderWorkerService> workerClass(int index) {
+        switch (index) {
+            case 0:
+                return Worker0.class;
+            case 1:
+                return Worker1.class;
+            case 2:
+                return Worker2.class;
+            case 3:
+                return Worker3.class;
+            default:
+                throw new IllegalArgumentException("There are only " + MAX_WORKERS + " workers");
+        }
+    }
+
+    private PdfiumCore core;
+    private PdfDocument document;
+    private ByteBuffer pixels;
+
+    private final IRenderWorker.Stub binder = new IRenderWorker.Stub() {
+        @Override
+        public int openDocument(ParcelFileDescriptor fd, String password) {
+            synchronized (RenderWorkerService.this) {
+                closeDocument();
+                try {
+                    document = core.newDocument(fd, password);
+                    return core.getPageCount(document);
+                } catch (PdfPasswordException e) {
+                    closeQuietly(fd);
+                    return ERROR_PASSWORD;
+                } catch (IOException e) {
+                    Log.e(TAG, "Cannot open document", e);
+                    closeQuietly(fd);
+                    return ERROR_IO;
+                }
+            }
+        }
+
+        @Override
+        public boolean setPixelBuffer(ParcelFileDescriptor fd, int size) {
+            synchronized (RenderWorkerService.this) {
+                releasePixels();
+                //Mapping stays valid after descriptor is closed
+                pixels = core.mapSharedMemory(fd, size);
+                closeQuietly(fd);
+                return pixels != null;
+            }
+        }
+
+        @Override
+        public boolean renderPage(int pageIndex, int width, int height, boolean renderAnnot) {
+            synchronized (RenderWorkerService.this) {
+                if (document == null || pixels == null || (long) width * height * 4 > pixels.capacity()) {
+                    return false;
+                }
+                //Pixels go straight into shared memory; page is closed so that a batch does
+                //not keep every page it rendered loaded
+                core.openPage(document, pageIndex);
+                try {
+                    return core.renderPageToBuffer(document, pageIndex, pixels, width, height, renderAnnot);
+                } finally {
+                    core.closePage(document, pageIndex);
+                }
+            }
+        }
+
+        @Override
+        public void close() {
+            synchronized (RenderWorkerService.this) {
+                closeDocument();
+                releasePixels();
+            }
+        }
+    };
+
+    @Override
+    public void onCreate() {
+        super.onCreate();
+        core = new PdfiumCore(this);
+    }
+
+    @Override
+    public IBinder onBind(Intent intent) {
+        return binder;
+    }
+
+    @Override
+    public synchronized void onDestroy() {
+        closeDocument();
+        releasePixels();
+        super.onDestroy();
+    }
+
+    private void closeDocument() {
+        if (document != null) {
+            core.closeDocument(document);
+            document = null;
+        }
+    }
+
+    private void releasePixels() {
+        if (pixels != null) {
+            core.unmapSharedMemory(pixels);
+            pixels = null;
+        }
+    }
+
+    private static void closeQuietly(ParcelFileDescriptor fd) {
+        try {
+            fd.close();
+        } catch (IOException e) {
+            /* ignore */
+        }
+    }
+}
@@ -0,0 +1,52 @@
+package com.shockwave.pdfium;
+
+import android.graphics.Bitmap;
+import android.graphics.Rect;
+
+/**
+ * Thumbnails of a range of pages packed into one bitmap, created by
+ * {@link PdfiumCore#renderThumbnails(PdfDocument, int, int, int)}.
+ * <p>
+ * Thumbnail of a page can be drawn with {@code canvas.drawBitmap(atlas.getBitmap(), atlas.getPageRect(page), dst, paint)}.
+ */
+public class ThumbnailAtlas {
+    private final Bitmap bitmap;
+    private final int fromPage;
+    private final int toPage;
+    private final int[] rects;
+
+    /*package*/ ThumbnailAtlas(Bitmap bitmap, int fromPage, int toPage, int[] layout) {
+        this.bitmap = bitmap;
+        this.fromPage = fromPage;
+        this.toPage = toPage;
+        this.rects = layout;
+    }
+
+    public Bitmap getBitmap() {
+        return bitmap;
+    }
+
+    public int getFromPage() {
+        return fromPage;
+    }
+
+    /** Last page in atlas, may be before the requested one if the rest did not fit */
+    public int getToPage() {
+        return toPage;
+    }
+
+    /** Area of atlas bitmap holding thumbnail of given page, null if page is out of range */
+    public Rect getPageRect(int pageIndex) {
+        if (pageIndex < fromPage || pageIndex > toPage) {
+            return null;
+        }
+        int offset = 2 + (pageIndex - fromPage) * 4;
+        return new Rect(rects[offset], rects[offset + 1],
+                rects[offset] + rects[offset + 2], rects[offset + 1] + rects[offset + 3]);
+    }
+
+    /** Release atlas bitmap, thumbnails cannot be drawn afterwards */
+    public void recycle() {
+        bitmap.recycle();
+    }
+}
@@ -42,7 +42,29 @@ LOCAL_CFLAGS += -DHAVE_PTHREADS
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/include
 LOCAL_SHARED_LIBRARIES += aospPdfium
 LOCAL_LDLIBS += -llog -landroid -ljnigraphics
-
-LOCAL_SRC_FILES :=  $(LOCAL_PATH)/src/mainJNILib.cpp
+LOCAL_STATIC_LIBRARIES += cpufeatures
+
+#NEON kernels are built only with NEON enabled; on armeabi-v7a it is not on by default,
+#the kernels are still chosen at runtime only if the CPU reports NEON
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+PIXEL_CONVERT_SRC := pixelConvert.cpp.neon
+else
+PIXEL_CONVERT_SRC := pixelConvert.cpp
+endif
+
+LOCAL_SRC_FILES :=  $(LOCAL_PATH)/src/mainJNILib.cpp \
+                    $(LOCAL_PATH)/src/$(PIXEL_CONVERT_SRC) \
+                    $(LOCAL_PATH)/src/scratchBuffer.cpp \
+                    $(LOCAL_PATH)/src/renderJob.cpp \
+                    $(LOCAL_PATH)/src/renderCache.cpp \
+                    $(LOCAL_PATH)/src/diskCache.cpp \
+                    $(LOCAL_PATH)/src/blockCache.cpp \
+                    $(LOCAL_PATH)/src/progressiveSource.cpp \
+                    $(LOCAL_PATH)/src/javaSource.cpp \
+                    $(LOCAL_PATH)/src/ioStats.cpp \
+                    $(LOCAL_PATH)/src/countedMutex.cpp \
+                    $(LOCAL_PATH)/src/sharedMemory.cpp
 
 include $(BUILD_SHARED_LIBRARY)
+
+$(call import-module,android/cpufeatures)
@@ -0,0 +1,171 @@
+/*
+ * Host-side microbenchmark for pixel conversion kernels.
+ *
+ * Build and run from src/main/jni:
+ *   g++ -O2 -Isrc bench/pixelConvertBench.cpp src/pixelConvert.cpp -lpthread -o /tmp/pixelConvertBench
+ *   /tmp/pixelConvertBench [width height iterations]
+ */
+#include "pixelConvert.hpp"
+
+extern "C" {
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <string.h>
+    #include <time.h>
+}
+
+#define RGBA_A(p) (((p) & 0xFF000000) >> 24)
+#define RGBA_R(p) (((p) & 0x00FF0000) >> 16)
+#define RGBA_G(p) (((p) & 0x0000FF00) >>  8)
+#define RGBA_B(p)  ((p) & 0x000000FF)
+#define MAKE_RGBA(r,g,b,a) (((a) << 24) | ((r) << 16) | ((g) << 8) | (b))
+
+// Loop previously used by nativeRenderPageBitmap, kept here as the baseline
+static void legacyChangeBitmapBR(int width, int height, void *pixels) {
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            uint32_t *pixel = ((uint32_t *)pixels) + y * width + x;
+            uint32_t v = *pixel;
+            *pixel = MAKE_RGBA(RGBA_B(v), RGBA_G(v), RGBA_R(v), RGBA_A(v));
+        }
+    }
+}
+
+// Scalar 565 conversion previously used for RGB_565 bitmaps, without dithering
+static void legacyBgrTo565(const uint8_t *src, int width, int height, uint16_t *dst) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++, src += 3) {
+            dst[y * width + x] = ((src[2] >> 3) << 11) | ((src[1] >> 2) << 5) | (src[0] >> 3);
+        }
+    }
+}
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void fillPattern(uint32_t *pixels, size_t count) {
+    uint32_t seed = 0x12345678;
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1664525 + 1013904223;
+        pixels[i] = seed;
+    }
+}
+
+int main(int argc, char **argv) {
+    // A4 page rendered at 2x of 144 dpi by default
+    int width = argc > 1 ? atoi(argv[1]) : 1654;
+    int height = argc > 2 ? atoi(argv[2]) : 2339;
+    int iterations = argc > 3 ? atoi(argv[3]) : 20;
+    size_t count = (size_t) width * height;
+
+    uint32_t *reference = (uint32_t*) malloc(count * 4);
+    uint32_t *pixels = (uint32_t*) malloc(count * 4);
+    fillPattern(reference, count);
+
+    printf("%dx%d, %d iterations (2 swaps per render)\n", width, height, iterations);
+
+    memcpy(pixels, reference, count * 4);
+    double start = nowMs();
+    for (int i = 0; i < iterations; i++) {
+        legacyChangeBitmapBR(width, height, pixels);
+        legacyChangeBitmapBR(width, height, pixels);
+    }
+    double legacyMs = (nowMs() - start) / iterations;
+    printf("%-8s %8.3f ms/render\n", "legacy", legacyMs);
+
+    // Validate every backend against the legacy loop, using a padded stride
+    int stride = width * 4 + 64;
+    uint8_t *padded = (uint8_t*) malloc((size_t) stride * height);
+    int failures = 0;
+
+    for (int b = 0; b < PIXEL_BACKEND_COUNT; b++) {
+        PixelBackend backend = (PixelBackend) b;
+        if (!pixelSelectBackend(backend)) {
+            continue;
+        }
+
+        memcpy(pixels, reference, count * 4);
+        legacyChangeBitmapBR(width, height, pixels);
+        for (int y = 0; y < height; y++) {
+            memcpy(padded + (size_t) y * stride, reference + (size_t) y * width, width * 4);
+            memset(padded + (size_t) y * stride + width * 4, 0xAB, stride - width * 4);
+        }
+        swizzleRB(padded, width, height, stride);
+        for (int y = 0; y < height; y++) {
+            const uint8_t *row = padded + (size_t) y * stride;
+            if (memcmp(row, pixels + (size_t) y * width, width * 4) != 0 || row[width * 4] != 0xAB) {
+                printf("%s: mismatch at row %d\n", pixelBackendName(backend), y);
+                failures++;
+                break;
+            }
+        }
+
+        start = nowMs();
+        for (int i = 0; i < iterations; i++) {
+            swizzleRB(padded, width, height, stride);
+            swizzleRB(padded, width, height, stride);
+        }
+        double ms = (nowMs() - start) / iterations;
+        printf("%-8s %8.3f ms/render  %5.2fx\n", pixelBackendName(backend), ms, legacyMs / ms);
+    }
+
+    // BGR -> RGB_565, checked against the scalar backend with and without dithering
+    uint8_t *bgr = (uint8_t*) reference;
+    int bgrStride = width * 3;
+    uint16_t *expected = (uint16_t*) malloc(count * 2);
+    uint16_t *expectedDither = (uint16_t*) malloc(count * 2);
+    uint16_t *converted = (uint16_t*) malloc(count * 2);
+
+    pixelSelectBackend(PIXEL_BACKEND_SCALAR);
+    bgrTo565(bgr, bgrStride, expectedDither, width * 2, width, height, true);
+
+    printf("\nBGR -> RGB_565\n");
+    start = nowMs();
+    for (int i = 0; i < iterations; i++) {
+        legacyBgrTo565(bgr, width, height, expected);
+    }
+    legacyMs = (nowMs() - start) / iterations;
+    printf("%-8s %8.3f ms/render\n", "legacy", legacyMs);
+
+    for (int b = 0; b < PIXEL_BACKEND_COUNT; b++) {
+        PixelBackend backend = (PixelBackend) b;
+        if (!pixelSelectBackend(backend)) {
+            continue;
+        }
+
+        bgrTo565(bgr, bgrStride, converted, width * 2, width, height, false);
+        if (memcmp(converted, expected, count * 2) != 0) {
+            printf("%s: 565 mismatch\n", pixelBackendName(backend));
+            failures++;
+        }
+        bgrTo565(bgr, bgrStride, converted, width * 2, width, height, true);
+        if (memcmp(converted, expectedDither, count * 2) != 0) {
+            printf("%s: dithered 565 mismatch\n", pixelBackendName(backend));
+            failures++;
+        }
+
+        start = nowMs();
+        for (int i = 0; i < iterations; i++) {
+            bgrTo565(bgr, bgrStride, converted, width * 2, width, height, false);
+        }
+        double ms = (nowMs() - start) / iterations;
+        start = nowMs();
+        for (int i = 0; i < iterations; i++) {
+            bgrTo565(bgr, bgrStride, converted, width * 2, width, height, true);
+        }
+        double ditherMs = (nowMs() - start) / iterations;
+        printf("%-8s %8.3f ms/render  %5.2fx  (dithered %.3f ms)\n",
+               pixelBackendName(backend), ms, legacyMs / ms, ditherMs);
+    }
+
+    free(converted);
+    free(expectedDither);
+    free(expected);
+    free(padded);
+    free(pixels);
+    free(reference);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+#include "util.hpp"
+#include "blockCache.hpp"
+
+extern "C" {
+    #include <errno.h>
+    #include <string.h>
+    #include <unistd.h>
+}
+
+using namespace android;
+
+ssize_t FdBlockSource::read(uint64_t position, void *out, size_t size) {
+    ssize_t got;
+    do {
+        got = pread(fd, out, size, (off_t) position);
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+        LOGE("Cannot read from file descriptor. Error:%d", errno);
+    }
+    return got;
+}
+
+BlockCache::BlockCache(BlockSource *source, uint64_t fileSize, size_t budget, size_t minReadBlocks)
+    : source(source), fileSize(fileSize), maxBlocks(budget / BLOCK_CACHE_BLOCK_SIZE),
+      minReadBlocks(minReadBlocks > 0 ? minReadBlocks : 1),
+      sequentialEnd(UINT64_MAX), readAhead(0) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+BlockCache::~BlockCache() {
+    for (BlockList::iterator it = blocks.begin(); it != blocks.end(); ++it) {
+        free(it->data);
+    }
+    delete source;
+}
+
+BlockCacheStats BlockCache::getStats() {
+    Mutex::Autolock autolock(lock);
+    return stats;
+}
+
+bool BlockCache::readSource(uint64_t position, void *out, size_t size) {
+    uint8_t *bytes = (uint8_t*) out;
+    while (size > 0) {
+        ssize_t got = source->read(position, bytes, size);
+        stats.syscalls++;
+        if (got < 0) {
+            return false;
+        }
+        if (got == 0) {
+            LOGE("Unexpected end of file at %llu", (unsigned long long) position);
+            return false;
+        }
+        bytes += got;
+        size -= got;
+        position += got;
+        stats.bytesRead += got;
+    }
+    return true;
+}
+
+//Read count consecutive blocks with one source read and insert them at the front
+bool BlockCache::load(uint64_t firstBlock, uint64_t count) {
+    uint64_t start = firstBlock * BLOCK_CACHE_BLOCK_SIZE;
+    uint64_t end = start + count * BLOCK_CACHE_BLOCK_SIZE;
+    if (end > fileSize) end = fileSize;
+    size_t length = (size_t) (end - start);
+
+    uint8_t *buffer = (uint8_t*) malloc(length);
+    if (buffer == NULL || !readSource(start, buffer, length)) {
+        free(buffer);
+        return false;
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        size_t offset = (size_t) i * BLOCK_CACHE_BLOCK_SIZE;
+        if (offset >= length) break;
+
+        Block block;
+        block.index = firstBlock + i;
+        block.length = length - offset < BLOCK_CACHE_BLOCK_SIZE ? length - offset : BLOCK_CACHE_BLOCK_SIZE;
+        block.data = (uint8_t*) malloc(block.length);
+        if (block.data == NULL) break;
+        memcpy(block.data, buffer + offset, block.length);
+
+        while (blocks.size() >= maxBlocks) {
+            BlockList::iterator last = blocks.end();
+            --last;
+            index.erase(last->index);
+            free(last->data);
+            blocks.erase(last);
+        }
+        blocks.push_front(block);
+        index[block.index] = blocks.begin();
+    }
+    free(buffer);
+    return true;
+}
+
+bool BlockCache::prefill(uint64_t position, size_t size) {
+    if (size == 0 || position >= fileSize) {
+        return true;
+    }
+    if (size > fileSize - position) size = (size_t) (fileSize - position);
+
+    Mutex::Autolock autolock(lock);
+
+    uint64_t maxCount = maxBlocks / 2;
+    if (maxCount == 0) {
+        return true;
+    }
+    uint64_t first = position / BLOCK_CACHE_BLOCK_SIZE;
+    uint64_t last = (position + size - 1) / BLOCK_CACHE_BLOCK_SIZE;
+    if (last - first + 1 > maxCount) last = first + maxCount - 1;
+
+    uint64_t blockIndex = first;
+    while (blockIndex <= last) {
+        if (index.find(blockIndex) != index.end()) {
+            blockIndex++;
+            continue;
+        }
+        uint64_t end = blockIndex + 1;
+        while (end <= last && index.find(end) == index.end()) end++;
+        if (!load(blockIndex, end - blockIndex)) {
+            return false;
+        }
+        blockIndex = end;
+    }
+    return true;
+}
+
+bool BlockCache::read(uint64_t position, void *out, size_t size) {
+    if (size == 0) {
+        return true;
+    }
+    if (position > fileSize || size > fileSize - position) {
+        LOGE("Read of %zu bytes at %llu is past end of file", size, (unsigned long long) position);
+        return false;
+    }
+
+    Mutex::Autolock autolock(lock);
+
+    //Large image streams would only flush the cache
+    if (maxBlocks == 0 || size > maxBlocks * BLOCK_CACHE_BLOCK_SIZE / 4) {
+        stats.misses++;
+        return readSource(position, out, size);
+    }
+
+    if (position == sequentialEnd) {
+        readAhead = readAhead == 0 ? 1 : readAhead * 2;
+        if (readAhead > BLOCK_CACHE_MAX_READ_AHEAD) readAhead = BLOCK_CACHE_MAX_READ_AHEAD;
+    } else {
+        readAhead = 0;
+    }
+    sequentialEnd = position + size;
+
+    uint64_t lastBlock = (fileSize - 1) / BLOCK_CACHE_BLOCK_SIZE;
+    uint64_t first = position / BLOCK_CACHE_BLOCK_SIZE;
+    uint64_t last = (position + size - 1) / BLOCK_CACHE_BLOCK_SIZE;
+    uint64_t loadedUntil = first;
+    uint8_t *dst = (uint8_t*) out;
+
+    for (uint64_t blockIndex = first; blockIndex <= last; blockIndex++) {
+        auto found = index.find(blockIndex);
+        if (found == index.end()) {
+            //Gather the run of missing blocks, followed by read-ahead past the request
+            uint64_t runEnd = blockIndex + 1;
+            while (runEnd <= last && index.find(runEnd) == index.end()) runEnd++;
+            uint64_t end = runEnd;
+            if (end > last) {
+                uint64_t limit = end + readAhead;
+                while (end < limit && end <= lastBlock && index.find(end) == index.end()) end++;
+            }
+            //Widen the read to the source's aligned chunk, over blocks not cached yet
+            uint64_t chunkStart = blockIndex / minReadBlocks * minReadBlocks;
+            uint64_t chunkEnd = chunkStart + minReadBlocks;
+            while (end < chunkEnd && end <= lastBlock && index.find(end) == index.end()) end++;
+            uint64_t start = blockIndex;
+            while (start > chunkStart && index.find(start - 1) == index.end()) start--;
+
+            uint64_t maxCount = maxBlocks / 2 > 0 ? maxBlocks / 2 : 1;
+            if (end - start > maxCount) start = blockIndex;
+            uint64_t count = end - start;
+            if (count > maxCount) count = maxCount;
+            stats.misses += (runEnd < start + count ? runEnd : start + count) - blockIndex;
+
+            if (!load(start, count)) {
+                return false;
+            }
+            loadedUntil = start + count;
+            found = index.find(blockIndex);
+            if (found == index.end()) {
+                return false;
+            }
+        } else if (blockIndex >= loadedUntil) {
+            stats.hits++;
+        }
+
+        BlockList::iterator it = found->second;
+        blocks.splice(blocks.begin(), blocks, it);
+
+        uint64_t blockStart = blockIndex * BLOCK_CACHE_BLOCK_SIZE;
+        uint64_t from = position > blockStart ? position - blockStart : 0;
+        uint64_t to = position + size - blockStart;
+        if (to > it->length) to = it->length;
+        memcpy(dst, it->data + from, (size_t) (to - from));
+        dst += to - from;
+    }
+    return true;
+}
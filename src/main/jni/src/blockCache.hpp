@@ -0,0 +1,94 @@
+#ifndef _BLOCK_CACHE_HPP_
+#define _BLOCK_CACHE_HPP_
+
+#include <utils/Mutex.h>
+
+#include <list>
+#include <unordered_map>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+//Size of cached blocks, a multiple of the memory page size
+#define BLOCK_CACHE_BLOCK_SIZE (16 * 1024)
+//Upper bound of sequential read-ahead, in blocks
+#define BLOCK_CACHE_MAX_READ_AHEAD 16
+
+struct BlockCacheStats {
+    int64_t hits;
+    int64_t misses;
+    int64_t syscalls; //reads from source: pread calls or calls into Java
+    int64_t bytesRead;
+};
+
+/** Storage the block cache reads from */
+class BlockSource {
+    public:
+    virtual ~BlockSource() {}
+
+    /** Read up to size bytes at position, returns bytes read, 0 at end of data or -1 on error */
+    virtual ssize_t read(uint64_t position, void *out, size_t size) = 0;
+};
+
+/** File descriptor source, the descriptor is not owned */
+class FdBlockSource : public BlockSource {
+    public:
+    explicit FdBlockSource(int fd) : fd(fd) {}
+    ssize_t read(uint64_t position, void *out, size_t size);
+
+    private:
+    int fd;
+};
+
+/**
+ * Page aligned LRU cache of file blocks for the FPDF_FILEACCESS callback.
+ * The parser reads cross-reference tables and object streams over and over in small
+ * pieces; those are served from memory. Misses are read in one pread together with
+ * neighbouring missing blocks, and when reads go forward sequentially the read-ahead
+ * window doubles up to BLOCK_CACHE_MAX_READ_AHEAD blocks. Sources with costly calls can ask
+ * for a minimum read of several blocks, misses are then extended to that aligned chunk.
+ * Budget of 0 disables caching, reads then go straight to the source. All methods are
+ * thread-safe.
+ */
+class BlockCache {
+    public:
+    /** Takes ownership of source */
+    BlockCache(BlockSource *source, uint64_t fileSize, size_t budget, size_t minReadBlocks = 1);
+    ~BlockCache();
+
+    /** Read exactly size bytes at position, short reads are retried. Returns false on error or EOF. */
+    bool read(uint64_t position, void *out, size_t size);
+
+    /**
+     * Load the missing blocks of the range into the cache without copying anything out, so
+     * later reads of it do not reach the source. Ranges larger than half the budget are
+     * clipped. Returns false on a source error.
+     */
+    bool prefill(uint64_t position, size_t size);
+
+    BlockCacheStats getStats();
+
+    private:
+    struct Block {
+        uint64_t index;
+        uint8_t *data;
+        size_t length;
+    };
+    typedef std::list<Block> BlockList;
+
+    android::Mutex lock;
+    BlockSource *source;
+    uint64_t fileSize;
+    size_t maxBlocks;
+    size_t minReadBlocks;
+    BlockList blocks; //most recently used first
+    std::unordered_map<uint64_t, BlockList::iterator> index;
+    uint64_t sequentialEnd;
+    int readAhead;
+    BlockCacheStats stats;
+
+    bool readSource(uint64_t position, void *out, size_t size);
+    bool load(uint64_t firstBlock, uint64_t count);
+};
+
+#endif
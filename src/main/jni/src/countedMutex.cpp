@@ -0,0 +1,28 @@
+#include "util.hpp"
+#include "countedMutex.hpp"
+
+CountedMutex::CountedMutex()
+    : acquisitions(0), contentions(0), waitNanos(0), maxWaitNanos(0) {
+}
+
+void CountedMutex::lock() {
+    if (mutex.tryLock() != 0) {
+        int64_t start = nowNanos();
+        mutex.lock();
+        int64_t waited = nowNanos() - start;
+        contentions++;
+        waitNanos += waited;
+        //Only the holder writes the maximum, no compare-and-swap needed
+        if (waited > maxWaitNanos.load()) maxWaitNanos.store(waited);
+    }
+    acquisitions++;
+}
+
+LockStats CountedMutex::getStats() {
+    LockStats stats;
+    stats.acquisitions = acquisitions.load();
+    stats.contentions = contentions.load();
+    stats.waitNanos = waitNanos.load();
+    stats.maxWaitNanos = maxWaitNanos.load();
+    return stats;
+}
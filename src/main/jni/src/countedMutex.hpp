@@ -0,0 +1,47 @@
+#ifndef _COUNTED_MUTEX_HPP_
+#define _COUNTED_MUTEX_HPP_
+
+#include <utils/Mutex.h>
+
+#include <atomic>
+#include <stdint.h>
+
+struct LockStats {
+    int64_t acquisitions;
+    int64_t contentions; //acquisitions which found the lock held and had to wait
+    int64_t waitNanos;
+    int64_t maxWaitNanos;
+};
+
+/**
+ * Mutex which counts how often and how long callers waited for it.
+ * An uncontended lock costs one tryLock, only waits are timed. Counters can be read
+ * from any thread without taking the lock.
+ */
+class CountedMutex {
+    public:
+    CountedMutex();
+
+    void lock();
+    void unlock() { mutex.unlock(); }
+
+    LockStats getStats();
+
+    class Autolock {
+        public:
+        explicit Autolock(CountedMutex &mutex) : mutex(mutex) { mutex.lock(); }
+        ~Autolock() { mutex.unlock(); }
+
+        private:
+        CountedMutex &mutex;
+    };
+
+    private:
+    android::Mutex mutex;
+    std::atomic<int64_t> acquisitions;
+    std::atomic<int64_t> contentions;
+    std::atomic<int64_t> waitNanos;
+    std::atomic<int64_t> maxWaitNanos;
+};
+
+#endif
@@ -0,0 +1,669 @@
+#include "util.hpp"
+#include "diskCache.hpp"
+
+extern "C" {
+    #include <dirent.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <string.h>
+    #include <stdio.h>
+    #include <sys/file.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+}
+
+#include <algorithm>
+#include <thread>
+#include <unordered_set>
+
+using namespace android;
+
+#define DISK_CACHE_MAGIC 0x43544450 //"PDTC"
+#define DISK_BLOB_MAGIC 0x42544450 //"PDTB"
+#define DISK_CACHE_VERSION 1
+#define DISK_CACHE_SLOTS 8192
+//Keep probe sequences short
+#define DISK_CACHE_MAX_LIVE (DISK_CACHE_SLOTS / 4 * 3)
+#define FINGERPRINT_CHUNK (64 * 1024)
+//Puts beyond this many queued bytes are dropped rather than held in memory
+#define DISK_CACHE_MAX_PENDING (16 * 1024 * 1024)
+
+enum SlotState {
+    SLOT_EMPTY = 0,
+    SLOT_VALID,
+    SLOT_DELETED
+};
+
+DiskTileCache sDiskTileCache;
+
+//FNV-1a over 64-bit words, remaining bytes are mixed one by one
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t length) {
+    const uint8_t *bytes = (const uint8_t*) data;
+    size_t words = length / 8;
+    for (size_t i = 0; i < words; i++, bytes += 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    for (size_t i = words * 8; i < length; i++, bytes++) {
+        hash = (hash ^ *bytes) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static const uint64_t HASH_SEED = 0xcbf29ce484222325ULL;
+
+static uint64_t hashRows(const void *rows, int stride, int rowBytes, int height) {
+    uint64_t hash = HASH_SEED;
+    const uint8_t *row = (const uint8_t*) rows;
+    for (int y = 0; y < height; y++, row += stride) {
+        hash = hashBytes(hash, row, rowBytes);
+    }
+    return hash;
+}
+
+static uint32_t slotChecksum(const DiskCacheSlot *slot) {
+    uint64_t hash = hashBytes(HASH_SEED, &slot->key, sizeof(slot->key));
+    hash = hashBytes(hash, &slot->blobId, sizeof(slot->blobId));
+    hash = hashBytes(hash, &slot->size, sizeof(slot->size));
+    return (uint32_t) (hash ^ (hash >> 32));
+}
+
+static bool writeAll(int fd, const void *data, size_t length) {
+    const uint8_t *bytes = (const uint8_t*) data;
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return true;
+}
+
+static bool readFully(int fd, void *data, size_t length, off_t offset) {
+    uint8_t *bytes = (uint8_t*) data;
+    while (length > 0) {
+        ssize_t got = pread(fd, bytes, length, offset);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (got == 0) return false;
+        bytes += got;
+        length -= got;
+        offset += got;
+    }
+    return true;
+}
+
+uint64_t fingerprintFile(int fd, uint64_t fileSize) {
+    uint64_t hash = hashBytes(HASH_SEED, &fileSize, sizeof(fileSize));
+    uint8_t *buffer = (uint8_t*) malloc(FINGERPRINT_CHUNK);
+    if (buffer == NULL) {
+        return hash;
+    }
+
+    size_t head = fileSize < FINGERPRINT_CHUNK ? (size_t) fileSize : FINGERPRINT_CHUNK;
+    if (readFully(fd, buffer, head, 0)) {
+        hash = hashBytes(hash, buffer, head);
+    }
+    if (fileSize > FINGERPRINT_CHUNK) {
+        //Trailer with document ID and cross-reference offsets is at the end
+        off_t tailOffset = (off_t) (fileSize - FINGERPRINT_CHUNK);
+        if (readFully(fd, buffer, FINGERPRINT_CHUNK, tailOffset)) {
+            hash = hashBytes(hash, buffer, FINGERPRINT_CHUNK);
+        }
+    }
+    free(buffer);
+    return hash;
+}
+
+uint64_t fingerprintMemory(const void *data, size_t size) {
+    uint64_t fileSize = size;
+    uint64_t hash = hashBytes(HASH_SEED, &fileSize, sizeof(fileSize));
+    size_t head = size < FINGERPRINT_CHUNK ? size : FINGERPRINT_CHUNK;
+    hash = hashBytes(hash, data, head);
+    if (size > FINGERPRINT_CHUNK) {
+        hash = hashBytes(hash, (const uint8_t*) data + size - FINGERPRINT_CHUNK, FINGERPRINT_CHUNK);
+    }
+    return hash;
+}
+
+DiskTileCache::DiskTileCache()
+    : indexFd(-1), header(NULL), slots(NULL), mappedSize(0), budget(0), used(0),
+      liveSlots(0), deletedSlots(0), writing(NULL), pendingBytes(0), writerStarted(false) {}
+
+DiskTileCache::~DiskTileCache() {
+    closeLocked();
+}
+
+bool DiskTileCache::open(const char *directory, size_t bytes) {
+    Mutex::Autolock autolock(lock);
+    discardPending();
+    closeLocked();
+
+    dir = directory;
+    budget = bytes;
+    if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        LOGE("Cannot create disk cache directory %s: %s", dir.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::string indexPath = dir + "/index";
+    indexFd = ::open(indexPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (indexFd < 0) {
+        LOGE("Cannot open disk cache index: %s", strerror(errno));
+        return false;
+    }
+    if (flock(indexFd, LOCK_EX | LOCK_NB) != 0) {
+        LOGE("Disk cache %s is used by another process", dir.c_str());
+        closeLocked();
+        return false;
+    }
+    if (!mapIndex()) {
+        closeLocked();
+        return false;
+    }
+
+    recover();
+    trimTo(budget, DISK_CACHE_MAX_LIVE);
+    LOGD("Disk cache opened with %u entries, %zu bytes", liveSlots, used);
+    return true;
+}
+
+void DiskTileCache::close() {
+    Mutex::Autolock autolock(lock);
+    discardPending();
+    closeLocked();
+}
+
+//Called under lock, returns once no blob is being written into the current directory
+void DiskTileCache::discardPending() {
+    for (size_t i = 0; i < pending.size(); i++) {
+        pendingBytes -= pending[i]->pixels.size();
+        delete pending[i];
+    }
+    pending.clear();
+    if (writing != NULL) {
+        writing->dropped = true;
+    }
+    while (writing != NULL) {
+        pendingChanged.wait(lock);
+    }
+}
+
+//Called under lock, newest queued entry wins
+const PendingBlob* DiskTileCache::findPending(const DiskCacheKey &key) {
+    for (size_t i = pending.size(); i > 0; i--) {
+        if (memcmp(&pending[i - 1]->key, &key, sizeof(key)) == 0) {
+            return pending[i - 1];
+        }
+    }
+    if (writing != NULL && !writing->dropped && memcmp(&writing->key, &key, sizeof(key)) == 0) {
+        return writing;
+    }
+    return NULL;
+}
+
+bool DiskTileCache::isOpen() {
+    Mutex::Autolock autolock(lock);
+    return slots != NULL;
+}
+
+void DiskTileCache::closeLocked() {
+    if (header != NULL) {
+        msync(header, mappedSize, MS_ASYNC);
+        munmap(header, mappedSize);
+    }
+    if (indexFd >= 0) {
+        ::close(indexFd); //Releases flock
+    }
+    indexFd = -1;
+    header = NULL;
+    slots = NULL;
+    mappedSize = 0;
+    used = 0;
+    liveSlots = 0;
+    deletedSlots = 0;
+}
+
+bool DiskTileCache::mapIndex() {
+    size_t size = sizeof(DiskCacheHeader) + (size_t) DISK_CACHE_SLOTS * sizeof(DiskCacheSlot);
+
+    bool valid = false;
+    struct stat st;
+    if (fstat(indexFd, &st) == 0 && (size_t) st.st_size == size) {
+        DiskCacheHeader existing;
+        valid = readFully(indexFd, &existing, sizeof(existing), 0) &&
+                existing.magic == DISK_CACHE_MAGIC && existing.version == DISK_CACHE_VERSION &&
+                existing.slotCount == DISK_CACHE_SLOTS && existing.slotSize == sizeof(DiskCacheSlot);
+    }
+    if (!valid) {
+        //Fresh, zero filled index, blobs of the old one are removed as unreferenced
+        if (ftruncate(indexFd, 0) != 0 || ftruncate(indexFd, size) != 0) {
+            LOGE("Cannot reset disk cache index: %s", strerror(errno));
+            return false;
+        }
+    }
+
+    void *mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, indexFd, 0);
+    if (mapped == MAP_FAILED) {
+        LOGE("Cannot map disk cache index: %s", strerror(errno));
+        return false;
+    }
+    mappedSize = size;
+    header = (DiskCacheHeader*) mapped;
+    slots = (DiskCacheSlot*) ((uint8_t*) mapped + sizeof(DiskCacheHeader));
+
+    if (!valid) {
+        header->version = DISK_CACHE_VERSION;
+        header->slotCount = DISK_CACHE_SLOTS;
+        header->slotSize = sizeof(DiskCacheSlot);
+        header->nextBlobId = 1;
+        header->clock = 0;
+        header->magic = DISK_CACHE_MAGIC;
+        msync(header, mappedSize, MS_SYNC);
+    }
+    return true;
+}
+
+//Drop torn slots and reinsert the rest, which also clears tombstones
+void DiskTileCache::rehash() {
+    std::vector<DiskCacheSlot> valid;
+    for (uint32_t i = 0; i < DISK_CACHE_SLOTS; i++) {
+        if (slots[i].state == SLOT_VALID && slots[i].checksum == slotChecksum(&slots[i])) {
+            valid.push_back(slots[i]);
+        }
+    }
+
+    memset(slots, 0, (size_t) DISK_CACHE_SLOTS * sizeof(DiskCacheSlot));
+    used = 0;
+    liveSlots = 0;
+    deletedSlots = 0;
+    for (size_t i = 0; i < valid.size(); i++) {
+        uint32_t index = (uint32_t) (hashBytes(HASH_SEED, &valid[i].key, sizeof(DiskCacheKey)) % DISK_CACHE_SLOTS);
+        while (slots[index].state == SLOT_VALID) {
+            index = (index + 1) % DISK_CACHE_SLOTS;
+        }
+        slots[index] = valid[i];
+        used += valid[i].size;
+        liveSlots++;
+    }
+}
+
+//Rehash index and remove blobs it does not reference
+void DiskTileCache::recover() {
+    rehash();
+
+    std::unordered_set<uint64_t> referenced;
+    uint64_t maxBlobId = 0;
+    for (uint32_t i = 0; i < DISK_CACHE_SLOTS; i++) {
+        if (slots[i].state == SLOT_VALID) {
+            referenced.insert(slots[i].blobId);
+            maxBlobId = std::max(maxBlobId, slots[i].blobId);
+        }
+    }
+
+    DIR *directory = opendir(dir.c_str());
+    if (directory != NULL) {
+        struct dirent *entry;
+        while ((entry = readdir(directory)) != NULL) {
+            const char *name = entry->d_name;
+            size_t length = strlen(name);
+            if (length < 4) continue;
+            const char *suffix = name + length - 3;
+            bool orphan;
+            if (strcmp(suffix, "tmp") == 0) {
+                orphan = true;
+            } else if (strcmp(suffix, ".px") == 0) {
+                uint64_t blobId = strtoull(name, NULL, 16);
+                maxBlobId = std::max(maxBlobId, blobId);
+                orphan = referenced.find(blobId) == referenced.end();
+            } else {
+                continue;
+            }
+            if (orphan) {
+                unlink((dir + "/" + name).c_str());
+            }
+        }
+        closedir(directory);
+    }
+
+    if (header->nextBlobId <= maxBlobId) {
+        header->nextBlobId = maxBlobId + 1;
+    }
+    msync(header, mappedSize, MS_ASYNC);
+}
+
+void DiskTileCache::setBudget(size_t bytes) {
+    Mutex::Autolock autolock(lock);
+    budget = bytes;
+    if (slots != NULL) {
+        trimTo(budget, DISK_CACHE_MAX_LIVE);
+    }
+}
+
+size_t DiskTileCache::getUsed() {
+    Mutex::Autolock autolock(lock);
+    return used;
+}
+
+std::string DiskTileCache::blobPath(uint64_t blobId, const char *suffix) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.%s", (unsigned long long) blobId, suffix);
+    return dir + name;
+}
+
+int DiskTileCache::findSlot(const DiskCacheKey &key) {
+    uint32_t index = (uint32_t) (hashBytes(HASH_SEED, &key, sizeof(key)) % DISK_CACHE_SLOTS);
+    for (uint32_t probe = 0; probe < DISK_CACHE_SLOTS; probe++) {
+        DiskCacheSlot *slot = &slots[index];
+        if (slot->state == SLOT_EMPTY) {
+            return -1;
+        }
+        if (slot->state == SLOT_VALID && memcmp(&slot->key, &key, sizeof(key)) == 0) {
+            return (int) index;
+        }
+        index = (index + 1) % DISK_CACHE_SLOTS;
+    }
+    return -1;
+}
+
+void DiskTileCache::removeSlot(uint32_t index) {
+    DiskCacheSlot *slot = &slots[index];
+    //Unpublish before deleting the blob
+    slot->state = SLOT_DELETED;
+    unlink(blobPath(slot->blobId, "px").c_str());
+    used -= slot->size;
+    liveSlots--;
+    deletedSlots++;
+}
+
+void DiskTileCache::trimTo(size_t bytes, uint32_t slotLimit) {
+    while ((used > bytes || liveSlots > slotLimit) && liveSlots > 0) {
+        int oldest = -1;
+        for (uint32_t i = 0; i < DISK_CACHE_SLOTS; i++) {
+            if (slots[i].state == SLOT_VALID &&
+                (oldest < 0 || slots[i].lastUse < slots[oldest].lastUse)) {
+                oldest = (int) i;
+            }
+        }
+        if (oldest < 0) break;
+        removeSlot((uint32_t) oldest);
+    }
+}
+
+void DiskTileCache::touch(DiskCacheSlot *slot) {
+    //Not covered by checksum, torn value only affects eviction order
+    slot->lastUse = ++header->clock;
+}
+
+bool DiskTileCache::get(const DiskCacheKey &key, void *dest, int destStride, int rowBytes) {
+    Mutex::Autolock autolock(lock);
+    if (slots == NULL) {
+        return false;
+    }
+    size_t size = (size_t) rowBytes * key.height;
+    const PendingBlob *queued = findPending(key);
+    if (queued != NULL) {
+        if (queued->pixels.size() != size) {
+            return false;
+        }
+        const uint8_t *pixels = &queued->pixels[0];
+        uint8_t *dst = (uint8_t*) dest;
+        for (int y = 0; y < key.height; y++, pixels += rowBytes, dst += destStride) {
+            memcpy(dst, pixels, rowBytes);
+        }
+        return true;
+    }
+    int index = findSlot(key);
+    if (index < 0) {
+        return false;
+    }
+    DiskCacheSlot *slot = &slots[index];
+    size_t fileSize = sizeof(DiskBlobHeader) + size;
+    if (slot->size != size) {
+        removeSlot((uint32_t) index);
+        return false;
+    }
+
+    bool valid = false;
+    int fd = ::open(blobPath(slot->blobId, "px").c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && (size_t) st.st_size == fileSize) {
+        void *mapped = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            const DiskBlobHeader *blob = (const DiskBlobHeader*) mapped;
+            const uint8_t *pixels = (const uint8_t*) mapped + sizeof(DiskBlobHeader);
+            valid = blob->magic == DISK_BLOB_MAGIC && blob->size == size &&
+                    memcmp(&blob->key, &key, sizeof(key)) == 0 &&
+                    blob->checksum == hashRows(pixels, rowBytes, rowBytes, key.height);
+            if (valid) {
+                uint8_t *dst = (uint8_t*) dest;
+                for (int y = 0; y < key.height; y++, pixels += rowBytes, dst += destStride) {
+                    memcpy(dst, pixels, rowBytes);
+                }
+            }
+            munmap(mapped, fileSize);
+        }
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+
+    if (!valid) {
+        LOGE("Disk cache blob %016llx is damaged", (unsigned long long) slot->blobId);
+        removeSlot((uint32_t) index);
+        return false;
+    }
+    touch(slot);
+    return true;
+}
+
+bool DiskTileCache::findPage(uint64_t fingerprint, int pageIndex, int flags, int *drawWidth, int *drawHeight) {
+    Mutex::Autolock autolock(lock);
+    if (slots == NULL) {
+        return false;
+    }
+    for (size_t i = pending.size(); i > 0; i--) {
+        const DiskCacheKey &key = pending[i - 1]->key;
+        if (key.fingerprint == fingerprint && key.pageIndex == pageIndex && key.flags == flags &&
+            key.startX == 0 && key.startY == 0 &&
+            key.width == key.drawWidth && key.height == key.drawHeight) {
+            *drawWidth = key.drawWidth;
+            *drawHeight = key.drawHeight;
+            return true;
+        }
+    }
+    const DiskCacheSlot *best = NULL;
+    for (uint32_t i = 0; i < DISK_CACHE_SLOTS; i++) {
+        const DiskCacheSlot *slot = &slots[i];
+        const DiskCacheKey &key = slot->key;
+        if (slot->state == SLOT_VALID && key.fingerprint == fingerprint &&
+            key.pageIndex == pageIndex && key.flags == flags &&
+            key.startX == 0 && key.startY == 0 &&
+            key.width == key.drawWidth && key.height == key.drawHeight &&
+            (best == NULL || slot->lastUse > best->lastUse)) {
+            best = slot;
+        }
+    }
+    if (best == NULL) {
+        return false;
+    }
+    *drawWidth = best->key.drawWidth;
+    *drawHeight = best->key.drawHeight;
+    return true;
+}
+
+void DiskTileCache::put(const DiskCacheKey &key, const void *src, int srcStride, int rowBytes) {
+    size_t size = (size_t) rowBytes * key.height;
+    {
+        Mutex::Autolock autolock(lock);
+        if (slots == NULL || size == 0 || size > budget || size > UINT32_MAX ||
+            pendingBytes + size > DISK_CACHE_MAX_PENDING) {
+            return;
+        }
+    }
+
+    //Copied outside the lock, lookups of other documents do not wait for it
+    PendingBlob *blob = new PendingBlob();
+    blob->key = key;
+    blob->dropped = false;
+    blob->pixels.resize(size);
+    const uint8_t *row = (const uint8_t*) src;
+    uint8_t *dst = &blob->pixels[0];
+    for (int y = 0; y < key.height; y++, row += srcStride, dst += rowBytes) {
+        memcpy(dst, row, rowBytes);
+    }
+
+    Mutex::Autolock autolock(lock);
+    if (slots == NULL) {
+        delete blob;
+        return;
+    }
+    for (std::deque<PendingBlob*>::iterator it = pending.begin(); it != pending.end(); ++it) {
+        if (memcmp(&(*it)->key, &key, sizeof(key)) == 0) {
+            pendingBytes -= (*it)->pixels.size();
+            delete *it;
+            pending.erase(it);
+            break;
+        }
+    }
+    pending.push_back(blob);
+    pendingBytes += size;
+    if (!writerStarted) {
+        //Lives as long as the process, like the cache itself
+        std::thread(&DiskTileCache::writeLoop, this).detach();
+        writerStarted = true;
+    }
+    pendingChanged.notify_all();
+}
+
+static bool writeBlob(const std::string &tmpPath, const std::string &path, const PendingBlob *pending) {
+    size_t size = pending->pixels.size();
+    int rowBytes = (int) (size / pending->key.height);
+
+    DiskBlobHeader blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.magic = DISK_BLOB_MAGIC;
+    blob.size = (uint32_t) size;
+    blob.key = pending->key;
+    blob.checksum = hashRows(&pending->pixels[0], rowBytes, rowBytes, pending->key.height);
+
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOGE("Cannot create disk cache blob: %s", strerror(errno));
+        return false;
+    }
+    bool written = writeAll(fd, &blob, sizeof(blob)) && writeAll(fd, &pending->pixels[0], size);
+    if (::close(fd) != 0) {
+        written = false;
+    }
+    //Blob becomes visible under its final name only when complete
+    if (!written || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        LOGE("Cannot write disk cache blob: %s", strerror(errno));
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void DiskTileCache::writeLoop() {
+    Mutex::Autolock autolock(lock);
+    while (true) {
+        while (pending.empty()) {
+            pendingChanged.wait(lock);
+        }
+        PendingBlob *blob = pending.front();
+        pending.pop_front();
+        if (slots == NULL) {
+            pendingBytes -= blob->pixels.size();
+            delete blob;
+            continue;
+        }
+        writing = blob;
+        uint64_t blobId = header->nextBlobId++;
+        std::string tmpPath = blobPath(blobId, "tmp");
+        std::string path = blobPath(blobId, "px");
+
+        //File is written without the lock, gets and puts go on meanwhile
+        lock.unlock();
+        bool written = writeBlob(tmpPath, path, blob);
+        lock.lock();
+
+        size_t size = blob->pixels.size();
+        if (written) {
+            if (blob->dropped || slots == NULL || size > budget) {
+                unlink(path.c_str());
+            } else {
+                publish(blob->key, blobId, size);
+            }
+        }
+        writing = NULL;
+        pendingBytes -= size;
+        delete blob;
+        pendingChanged.notify_all();
+    }
+}
+
+//Called under lock with the blob already in place
+void DiskTileCache::publish(const DiskCacheKey &key, uint64_t blobId, size_t size) {
+    int existing = findSlot(key);
+    if (existing >= 0) {
+        removeSlot((uint32_t) existing);
+    }
+    trimTo(budget - size, DISK_CACHE_MAX_LIVE - 1);
+    if (deletedSlots > DISK_CACHE_SLOTS / 4) {
+        //Misses probe past tombstones, so do not let them pile up
+        rehash();
+    }
+
+    uint32_t index = (uint32_t) (hashBytes(HASH_SEED, &key, sizeof(key)) % DISK_CACHE_SLOTS);
+    while (slots[index].state == SLOT_VALID) {
+        index = (index + 1) % DISK_CACHE_SLOTS;
+    }
+    DiskCacheSlot *slot = &slots[index];
+    if (slot->state == SLOT_DELETED) {
+        deletedSlots--;
+    }
+    slot->key = key;
+    slot->blobId = blobId;
+    slot->size = (uint32_t) size;
+    slot->reserved = 0;
+    slot->checksum = slotChecksum(slot);
+    touch(slot);
+    //Publish last, a torn slot fails its checksum on next open
+    __sync_synchronize();
+    slot->state = SLOT_VALID;
+    used += size;
+    liveSlots++;
+    msync(header, mappedSize, MS_ASYNC);
+}
+
+void DiskTileCache::removeDocument(uint64_t fingerprint) {
+    Mutex::Autolock autolock(lock);
+    if (slots == NULL) {
+        return;
+    }
+    for (std::deque<PendingBlob*>::iterator it = pending.begin(); it != pending.end();) {
+        if ((*it)->key.fingerprint == fingerprint) {
+            pendingBytes -= (*it)->pixels.size();
+            delete *it;
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (writing != NULL && writing->key.fingerprint == fingerprint) {
+        writing->dropped = true;
+    }
+    for (uint32_t i = 0; i < DISK_CACHE_SLOTS; i++) {
+        if (slots[i].state == SLOT_VALID && slots[i].key.fingerprint == fingerprint) {
+            removeSlot(i);
+        }
+    }
+}
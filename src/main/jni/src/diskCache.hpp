@@ -0,0 +1,146 @@
+#ifndef _DISK_CACHE_HPP_
+#define _DISK_CACHE_HPP_
+
+#include <utils/Mutex.h>
+
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Persistent cache of rendered tiles and thumbnails.
+ *
+ * Cache directory holds an index file and one blob file per entry:
+ *
+ *   index           DiskCacheHeader followed by slotCount DiskCacheSlots, an open addressing
+ *                   hash table which is mmapped and probed in place, nothing is parsed on open
+ *   <blobId>.px     DiskBlobHeader followed by pixel rows without padding
+ *
+ * Writes are queued and done by a writer thread, so renders do not wait for the disk; queued
+ * entries are served from memory until written. Writes are crash safe: blob is written to
+ * <blobId>.tmp and renamed before its slot is published, slot and blob carry checksums which are verified before use. Anything torn
+ * by a crash is treated as a miss and removed, blobs not referenced by the index are
+ * deleted on open. Entries are evicted least recently used first to stay within the byte
+ * budget. Index is locked with flock, so only one process at a time uses a directory.
+ */
+
+//Identifies one rendered bitmap independently of the process, see RenderCacheKey
+struct DiskCacheKey {
+    uint64_t fingerprint;
+    int32_t pageIndex;
+    int32_t flags;
+    int32_t drawWidth;
+    int32_t drawHeight;
+    int32_t startX;
+    int32_t startY;
+    int32_t width;
+    int32_t height;
+};
+
+struct DiskCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    uint64_t nextBlobId;
+    uint64_t clock;
+    uint8_t reserved[32];
+};
+
+struct DiskCacheSlot {
+    DiskCacheKey key;
+    uint64_t blobId;
+    uint64_t lastUse;
+    uint32_t size;
+    uint32_t state;
+    uint32_t checksum;
+    uint32_t reserved;
+};
+
+struct DiskBlobHeader {
+    uint32_t magic;
+    uint32_t size;
+    DiskCacheKey key;
+    uint64_t checksum;
+};
+
+//Rows waiting for the writer thread, packed without padding
+struct PendingBlob {
+    DiskCacheKey key;
+    std::vector<uint8_t> pixels;
+    bool dropped; //removed while being written, blob is deleted instead of published
+};
+
+/** Content fingerprint of a PDF file: its size, first and last 64KB */
+uint64_t fingerprintFile(int fd, uint64_t fileSize);
+
+/** Content fingerprint of a PDF held in memory */
+uint64_t fingerprintMemory(const void *data, size_t size);
+
+class DiskTileCache {
+    public:
+    DiskTileCache();
+    ~DiskTileCache();
+
+    /** Open (or create) cache in given directory, closing the previous one */
+    bool open(const char *dir, size_t budget);
+    void close();
+    bool isOpen();
+
+    void setBudget(size_t bytes);
+    size_t getUsed();
+
+    /** Copy cached rows into dest; returns false on miss */
+    bool get(const DiskCacheKey &key, void *dest, int destStride, int rowBytes);
+
+    /** Find a cached full page render, returns false if there is none */
+    bool findPage(uint64_t fingerprint, int pageIndex, int flags, int *drawWidth, int *drawHeight);
+
+    /**
+     * Queue given rows for writing, evicting least recently used entries to stay in budget
+     * once written. Rows are copied, nothing is written on the calling thread.
+     */
+    void put(const DiskCacheKey &key, const void *src, int srcStride, int rowBytes);
+
+    /** Drop all entries of given document */
+    void removeDocument(uint64_t fingerprint);
+
+    private:
+    android::Mutex lock;
+    std::string dir;
+    int indexFd;
+    DiskCacheHeader *header;
+    DiskCacheSlot *slots;
+    size_t mappedSize;
+    size_t budget;
+    size_t used;
+    uint32_t liveSlots;
+    uint32_t deletedSlots;
+    //Oldest first, guarded by lock like the index
+    std::deque<PendingBlob*> pending;
+    PendingBlob *writing;
+    size_t pendingBytes;
+    bool writerStarted;
+    std::condition_variable_any pendingChanged;
+
+    void closeLocked();
+    void discardPending();
+    const PendingBlob* findPending(const DiskCacheKey &key);
+    void writeLoop();
+    void publish(const DiskCacheKey &key, uint64_t blobId, size_t size);
+    bool mapIndex();
+    void recover();
+    void rehash();
+    int findSlot(const DiskCacheKey &key);
+    void removeSlot(uint32_t index);
+    void trimTo(size_t bytes, uint32_t slotLimit);
+    void touch(DiskCacheSlot *slot);
+    std::string blobPath(uint64_t blobId, const char *suffix);
+};
+
+extern DiskTileCache sDiskTileCache;
+
+#endif
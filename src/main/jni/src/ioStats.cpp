@@ -0,0 +1,44 @@
+#include "ioStats.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+using namespace android;
+
+IoStatsRecorder::IoStatsRecorder() : fileSize(0) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+void IoStatsRecorder::setFileSize(uint64_t size) {
+    Mutex::Autolock autolock(lock);
+    fileSize = size;
+}
+
+void IoStatsRecorder::record(uint64_t position, size_t size, int64_t nanos, bool succeeded) {
+    int latencyBucket = 0;
+    for (int64_t micros = nanos / 1000; micros > 0 && latencyBucket < IO_LATENCY_BUCKETS - 1; micros >>= 1) {
+        latencyBucket++;
+    }
+
+    Mutex::Autolock autolock(lock);
+    stats.calls++;
+    if (!succeeded) {
+        stats.failures++;
+    } else {
+        stats.bytes += size;
+    }
+    stats.totalNanos += nanos;
+    if (nanos > stats.maxNanos) {
+        stats.maxNanos = nanos;
+    }
+    stats.latency[latencyBucket]++;
+    if (position < fileSize) {
+        stats.offsets[position * IO_OFFSET_BUCKETS / fileSize]++;
+    }
+}
+
+IoStats IoStatsRecorder::get() {
+    Mutex::Autolock autolock(lock);
+    return stats;
+}
@@ -0,0 +1,45 @@
+#ifndef _IO_STATS_HPP_
+#define _IO_STATS_HPP_
+
+#include <utils/Mutex.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Bucket i counts reads which took less than 2^i microseconds, the last one all slower reads
+#define IO_LATENCY_BUCKETS 16
+//File is split into this many equal ranges, each counting the reads starting in it
+#define IO_OFFSET_BUCKETS 32
+
+struct IoStats {
+    int64_t calls;
+    int64_t bytes;
+    int64_t failures;
+    int64_t totalNanos;
+    int64_t maxNanos;
+    int64_t latency[IO_LATENCY_BUCKETS];
+    int64_t offsets[IO_OFFSET_BUCKETS];
+};
+
+/**
+ * Counters of the reads PDFium makes from a document, to tell slow storage (latency),
+ * scattered cross-reference layout (offsets) and repeated reads (bytes over file size)
+ * apart. All methods are thread-safe.
+ */
+class IoStatsRecorder {
+    public:
+    IoStatsRecorder();
+
+    void setFileSize(uint64_t size);
+
+    void record(uint64_t position, size_t size, int64_t nanos, bool succeeded);
+
+    IoStats get();
+
+    private:
+    android::Mutex lock;
+    uint64_t fileSize;
+    IoStats stats;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "javaSource.hpp"
+
+JavaBlockSource* JavaBlockSource::create(JNIEnv *env, jobject source) {
+    jclass sourceClass = env->GetObjectClass(source);
+    jmethodID readMethod = env->GetMethodID(sourceClass, "read", "(J[BII)I");
+    env->DeleteLocalRef(sourceClass);
+    if (readMethod == NULL) {
+        return NULL;
+    }
+    jbyteArray buffer = env->NewByteArray(JAVA_SOURCE_BUFFER_SIZE);
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    JavaBlockSource *javaSource = new JavaBlockSource();
+    env->GetJavaVM(&javaSource->vm);
+    javaSource->readMethod = readMethod;
+    javaSource->source = env->NewGlobalRef(source);
+    javaSource->buffer = (jbyteArray) env->NewGlobalRef(buffer);
+    env->DeleteLocalRef(buffer);
+    if (javaSource->source == NULL || javaSource->buffer == NULL) {
+        delete javaSource;
+        return NULL;
+    }
+    return javaSource;
+}
+
+JavaBlockSource::~JavaBlockSource() {
+    JNIEnv *env;
+    if (vm == NULL || vm->GetEnv((void**) &env, JNI_VERSION_1_6) != JNI_OK) {
+        LOGE("Java source closed on detached thread, references leak");
+        return;
+    }
+    if (source != NULL) env->DeleteGlobalRef(source);
+    if (buffer != NULL) env->DeleteGlobalRef(buffer);
+}
+
+ssize_t JavaBlockSource::read(uint64_t position, void *out, size_t size) {
+    JNIEnv *env;
+    if (vm->GetEnv((void**) &env, JNI_VERSION_1_6) != JNI_OK) {
+        LOGE("Java source read on detached thread");
+        return -1;
+    }
+    if (size > JAVA_SOURCE_BUFFER_SIZE) {
+        size = JAVA_SOURCE_BUFFER_SIZE;
+    }
+
+    jint got = env->CallIntMethod(source, readMethod, (jlong) position, buffer, 0, (jint) size);
+    if (env->ExceptionCheck()) {
+        //Parser sees failed read, document open or render then reports the error
+        LOGE("Java source threw on read of %zu bytes at %llu", size, (unsigned long long) position);
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+        return -1;
+    }
+    if (got < 0) {
+        return 0;
+    }
+    if ((size_t) got > size) {
+        LOGE("Java source returned more bytes than asked for");
+        return -1;
+    }
+    env->GetByteArrayRegion(buffer, 0, got, (jbyte*) out);
+    return got;
+}
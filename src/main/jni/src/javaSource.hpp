@@ -0,0 +1,37 @@
+#ifndef _JAVA_SOURCE_HPP_
+#define _JAVA_SOURCE_HPP_
+
+#include "util.hpp"
+#include "blockCache.hpp"
+
+//Bytes moved per call into Java, larger reads take several calls
+#define JAVA_SOURCE_BUFFER_SIZE (256 * 1024)
+//Minimum block cache read from Java source, in blocks
+#define JAVA_SOURCE_MIN_READ_BLOCKS 4
+
+/**
+ * Block source backed by a Java com.shockwave.pdfium.DocumentSource, for documents that
+ * are not in a file, e.g. in an encrypted store. Reads go through one reused Java byte
+ * array and must come from threads attached to the VM, which all callers of PDFium are.
+ * Put behind a BlockCache with large minimum reads, so parser blocks do not each cost
+ * a call into Java.
+ */
+class JavaBlockSource : public BlockSource {
+    public:
+    ~JavaBlockSource();
+
+    /** Returns NULL with Java exception pending if source cannot be used */
+    static JavaBlockSource* create(JNIEnv *env, jobject source);
+
+    ssize_t read(uint64_t position, void *out, size_t size);
+
+    private:
+    JavaBlockSource() : vm(NULL), source(NULL), buffer(NULL), readMethod(NULL) {}
+
+    JavaVM *vm;
+    jobject source;
+    jbyteArray buffer;
+    jmethodID readMethod;
+};
+
+#endif
@@ -1,7 +1,20 @@
 #include "util.hpp"
+#include "pixelConvert.hpp"
+#include "scratchBuffer.hpp"
+#include "renderJob.hpp"
+#include "renderCache.hpp"
+#include "diskCache.hpp"
+#include "blockCache.hpp"
+#include "progressiveSource.hpp"
+#include "javaSource.hpp"
+#include "ioStats.hpp"
+#include "countedMutex.hpp"
+#include "sharedMemory.hpp"
 
 extern "C" {
     #include <unistd.h>
+    #include <errno.h>
+    #include <fcntl.h>
     #include <sys/mman.h>
     #include <sys/stat.h>
     #include <string.h>
@@ -18,22 +31,25 @@ using namespace android;
 #include <fpdf_doc.h>
 #include <fpdf_text.h>
 #include <fpdf_formfill.h>
+#include <fpdf_dataavail.h>
+#include <fpdf_edit.h>
+#include <list>
+#include <map>
 #include <string>
 #include <vector>
-
-#define RGB565_R(p) ((((p) & 0xF800) >> 11) << 3)
-#define RGB565_G(p) ((((p) & 0x7E0 ) >> 5)  << 2)
-#define RGB565_B(p) ( ((p) & 0x1F  )        << 3)
-#define MAKE_RGB565(r,g,b) ((((r) >> 3) << 11) | (((g) >> 2) << 5) | ((b) >> 3))
-
-#define RGBA_A(p) (((p) & 0xFF000000) >> 24)
-#define RGBA_R(p) (((p) & 0x00FF0000) >> 16)
-#define RGBA_G(p) (((p) & 0x0000FF00) >>  8)
-#define RGBA_B(p)  ((p) & 0x000000FF)
-#define MAKE_RGBA(r,g,b,a) (((a) << 24) | ((r) << 16) | ((g) << 8) | (b))
+#include <unordered_map>
+#include <unordered_set>
 
 static Mutex sLibraryLock;
 
+//PDFium keeps process-wide state (fonts, codecs, page caches) and is not thread-safe, so every
+//call into it is serialized here, whichever document it is for. Natives taking a document
+//lock it first and the engine second, and hold the engine only while PDFium works: cache
+//hits, pixel conversion and copying results to Java run without it. Long bitmap renders
+//give it up between slices of RENDER_SLICE_NANOS.
+static CountedMutex sEngineLock;
+#define RENDER_SLICE_NANOS (8 * 1000000LL)
+
 static int sLibraryReferenceCount = 0;
 
 static void initLibraryIfNeed(){
@@ -54,10 +70,63 @@ static void destroyLibraryIfNeed(){
     }
 }
 
-struct rgb {
-    uint8_t red;
-    uint8_t green;
-    uint8_t blue;
+//Stages of nativeRenderPageBitmap, times are accumulated in nanoseconds
+enum RenderStage {
+    RENDER_STAGE_LOCK = 0,
+    RENDER_STAGE_PAGE,
+    RENDER_STAGE_FORM,
+    RENDER_STAGE_CONVERT,
+    RENDER_STAGE_COUNT
+};
+
+struct RenderStats {
+    int64_t renderCount = 0;
+    int64_t formRenderCount = 0;
+    //Full-frame passes over pixels made after rasterization (byte order / format conversion)
+    int64_t conversionPasses = 0;
+    int64_t cacheHits = 0;
+    int64_t cacheMisses = 0;
+    int64_t diskCacheHits = 0;
+    int64_t diskCacheMisses = 0;
+    //Renders which asked for form widgets, but took the form-free path as document has no form
+    int64_t formSkipCount = 0;
+    int64_t stageNanos[RENDER_STAGE_COUNT] = {};
+};
+
+//Budget of block cache given to documents opened from file descriptor
+static std::atomic<size_t> sBlockCacheBudget(1024 * 1024);
+
+template <class string_type>
+inline typename string_type::value_type* WriteInto(string_type* str, size_t length_with_null) {
+  str->reserve(length_with_null);
+  str->resize(length_with_null - 1);
+  return &((*str)[0]);
+}
+
+//Links of a page with a destination or URI, packed for one transfer to Java
+struct PageLinks {
+    std::vector<float> rects;  //[left, top, right, bottom] per link
+    std::vector<jint> info;    //[destination page or -1, URI index or -1, first quad, quad count] per link
+    std::vector<float> quads;  //[x1, y1, ... x4, y4] per quad
+    std::vector<std::string> uris;
+};
+
+//File as seen by fstat, an unchanged file keeps its identity across opens
+struct FileIdentity {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    //Nanoseconds too, a file rewritten to the same size within a second must not match
+    time_t mtimeSec;
+    long mtimeNsec;
+
+    bool operator<(const FileIdentity &other) const {
+        if(device != other.device) return device < other.device;
+        if(inode != other.inode) return inode < other.inode;
+        if(size != other.size) return size < other.size;
+        if(mtimeSec != other.mtimeSec) return mtimeSec < other.mtimeSec;
+        return mtimeNsec < other.mtimeNsec;
+    }
 };
 
 class DocumentFile {
@@ -67,25 +136,447 @@ class DocumentFile {
     public:
     FPDF_DOCUMENT pdfDocument = NULL;
     FPDF_FORMHANDLE m_form = NULL;
+    //False only if document is known to have no AcroForm, renders then skip form setup and
+    //drawing. Found out on first form render, see checkForm
+    bool hasForm = true;
+    bool formChecked = false;
     size_t fileSize;
+    //Reads of file backed documents, deleted after the document
+    BlockCache *blockCache = NULL;
+    //Data of progressively loaded document, deleted after the availability provider
+    ProgressiveSource *progressive = NULL;
+    //Document bytes when they are in memory: read-only mapping of the file (unmapped after
+    //the document), owned copy (freed after the document) or direct buffer pinned by Java
+    const uint8_t *memoryData = NULL;
+    size_t memorySize = 0;
+    bool memoryMapped = false;
+    bool memoryOwned = false;
+    //Content fingerprint for disk cache, 0 if disk cache was not open when document was loaded
+    uint64_t fingerprint = 0;
+    RenderStats renderStats;
+    //Every read PDFium makes, whatever the data source
+    IoStatsRecorder ioStats;
+    //Documents opened from files are shared by handles to the same file, see DocumentRegistry
+    int references = 1;
+    bool registered = false;
+    FileIdentity identity;
+    std::string password;
+    //Duplicate of the descriptor document was opened with, so it outlives the caller's one
+    int ownedFd = -1;
+    //Guards all of the above and the private state below, taken before sEngineLock. Handles
+    //sharing this document through DocumentRegistry are serialized by it too.
+    CountedMutex lock;
 
     DocumentFile() { initLibraryIfNeed(); }
     ~DocumentFile();
+
+    //Form fill environment is created on first form render and lives as long as the document.
+    //Each page is announced to it once, before its first form render, and taken back on close.
+    bool initForm();
+    bool prepareFormPage(FPDF_PAGE page);
+    bool checkForm();
+    FPDF_PAGE loadPage(int pageIndex);
+    void closePage(FPDF_PAGE page);
+
+    //[width, height, rotation] per page; sizes in points are computed once, rotation is
+    //read from pages currently loaded and -1 for the others
+    std::vector<float> getPageSizes();
+
+    //Links of loaded page, extracted on first request and kept until page is closed
+    const PageLinks& getPageLinks(FPDF_PAGE page);
+
+    FPDF_DOCUMENT load(const FPDF_FILEACCESS &access, const char *password);
+
+    //Progressive loading: availability provider asks the source which ranges are present,
+    //and missing ones are queued in the source as requests. Status values are PDF_DATA_*.
+    bool startProgressive(ProgressiveSource *source);
+    int isDocumentAvailable();
+    FPDF_DOCUMENT loadAvailable(const char *password);
+    int isPageAvailable(int pageIndex);
+    int getFirstPageNum();
+
+    //Hint kernel about coming access pattern of mapped file, no-op for other documents
+    void adviseAccess(int advice){
+        if(memoryMapped && madvise((void*)memoryData, memorySize, advice) != 0){
+            LOGE("madvise failed: %s", strerror(errno));
+        }
+    }
+
+    private:
+    //Availability provider and the interfaces it points to live as long as the document.
+    //fileAccess given to PDFium counts reads and forwards them to sourceAccess.
+    FPDF_FILEACCESS fileAccess;
+    FPDF_FILEACCESS sourceAccess;
+    FX_FILEAVAIL fileAvail;
+    FPDF_AVAIL avail = NULL;
+
+    //PDFium keeps pointers to these, they must outlive m_form
+    IPDF_JSPLATFORM platformCallbacks;
+    FPDF_FORMFILLINFO formCallbacks;
+    bool formInitFailed = false;
+    std::unordered_set<FPDF_PAGE> formPages;
+    //Loaded pages and their indices
+    std::unordered_map<FPDF_PAGE, int> openPages;
+    //[width, height] in points per page, empty until first asked for
+    std::vector<float> pageSizes;
+    std::unordered_map<FPDF_PAGE, PageLinks> pageLinks;
+
+    void setSourceAccess(const FPDF_FILEACCESS &access);
+    std::vector<float> withRotations(const std::vector<float> &sizes, int pageCount);
+    static int getInstrumentedBlock(void *param, unsigned long position, unsigned char *outBuffer,
+                                    unsigned long size);
 };
+
+extern "C" int PDFForm_Alert(IPDF_JSPLATFORM*, FPDF_WIDESTRING, FPDF_WIDESTRING, int, int);
+
+bool DocumentFile::initForm(){
+    if(m_form != NULL) return true;
+    if(formInitFailed || pdfDocument == NULL) return false;
+
+    memset(&platformCallbacks, '\0', sizeof(platformCallbacks));
+    platformCallbacks.version = 1;
+    platformCallbacks.app_alert = PDFForm_Alert;
+
+    memset(&formCallbacks, '\0', sizeof(formCallbacks));
+    formCallbacks.version = 1;
+    formCallbacks.m_pJsPlatform = &platformCallbacks;
+
+    m_form = FPDFDOC_InitFormFillEnvironment(pdfDocument, &formCallbacks);
+    if(m_form == NULL){
+        LOGE("Cannot init form fill environment");
+        formInitFailed = true;
+        return false;
+    }
+
+    FPDF_SetFormFieldHighlightColor(m_form, 0, 0xFFFFFF);
+    FPDF_SetFormFieldHighlightAlpha(m_form, 100);
+    FORM_DoDocumentJSAction(m_form);
+    FORM_DoDocumentOpenAction(m_form);
+    LOGD("Form fill environment created");
+    return true;
+}
+
+bool DocumentFile::prepareFormPage(FPDF_PAGE page){
+    if(!initForm()) return false;
+    if(formPages.insert(page).second){
+        FORM_OnAfterLoadPage(page, m_form);
+        FORM_DoPageAAction(page, m_form, FPDFPAGE_AACTION_OPEN);
+    }
+    return true;
+}
+
+FPDF_PAGE DocumentFile::loadPage(int pageIndex){
+    FPDF_PAGE page = FPDF_LoadPage(pdfDocument, pageIndex);
+    if(page != NULL){
+        openPages[page] = pageIndex;
+    }
+    return page;
+}
+
+void DocumentFile::closePage(FPDF_PAGE page){
+    if(formPages.erase(page) > 0){
+        FORM_DoPageAAction(page, m_form, FPDFPAGE_AACTION_CLOSE);
+        FORM_OnBeforeClosePage(page, m_form);
+    }
+    openPages.erase(page);
+    pageLinks.erase(page);
+    FPDF_ClosePage(page);
+}
+
+const PageLinks& DocumentFile::getPageLinks(FPDF_PAGE page){
+    auto cached = pageLinks.find(page);
+    if(cached != pageLinks.end()) return cached->second;
+
+    PageLinks &links = pageLinks[page];
+    int pos = 0;
+    FPDF_LINK link;
+    while(FPDFLink_Enumerate(page, &pos, &link)){
+        FS_RECTF rect;
+        if(!FPDFLink_GetAnnotRect(link, &rect)) continue;
+
+        jint destIndex = -1;
+        FPDF_DEST dest = FPDFLink_GetDest(pdfDocument, link);
+        if(dest != NULL){
+            destIndex = (jint)FPDFDest_GetPageIndex(pdfDocument, dest);
+        }
+        jint uriIndex = -1;
+        FPDF_ACTION action = FPDFLink_GetAction(link);
+        if(action != NULL){
+            unsigned long length = FPDFAction_GetURIPath(pdfDocument, action, NULL, 0);
+            std::string uri;
+            if(length > 0){
+                FPDFAction_GetURIPath(pdfDocument, action, WriteInto(&uri, length), length);
+            }
+            uriIndex = (jint)links.uris.size();
+            links.uris.push_back(uri);
+        }
+        if(destIndex < 0 && uriIndex < 0) continue;
+
+        links.rects.push_back(rect.left);
+        links.rects.push_back(rect.top);
+        links.rects.push_back(rect.right);
+        links.rects.push_back(rect.bottom);
+
+        jint firstQuad = (jint)(links.quads.size() / 8);
+        int quadCount = FPDFLink_CountQuadPoints(link);
+        for(int i = 0; i < quadCount; i++){
+            FS_QUADPOINTSF quad;
+            if(!FPDFLink_GetQuadPoints(link, i, &quad)) continue;
+            float points[8] = { quad.x1, quad.y1, quad.x2, quad.y2, quad.x3, quad.y3, quad.x4, quad.y4 };
+            links.quads.insert(links.quads.end(), points, points + 8);
+        }
+        links.info.push_back(destIndex);
+        links.info.push_back(uriIndex);
+        links.info.push_back(firstQuad);
+        links.info.push_back((jint)(links.quads.size() / 8) - firstQuad);
+    }
+    return links;
+}
+
+std::vector<float> DocumentFile::getPageSizes(){
+    if(pdfDocument == NULL) return std::vector<float>();
+    int pageCount = FPDF_GetPageCount(pdfDocument);
+    if(pageSizes.size() != (size_t)pageCount * 2){
+        std::vector<float> sizes((size_t)pageCount * 2);
+        bool complete = true;
+        for(int i = 0; i < pageCount; i++){
+            double width, height;
+            if(!FPDF_GetPageSizeByIndex(pdfDocument, i, &width, &height)){
+                width = 0;
+                height = 0;
+                complete = false;
+            }
+            sizes[i * 2] = (float)width;
+            sizes[i * 2 + 1] = (float)height;
+        }
+        //Pages of progressive document may not have arrived yet, ask again later
+        if(!complete && progressive != NULL && !progressive->isComplete()){
+            return withRotations(sizes, pageCount);
+        }
+        pageSizes.swap(sizes);
+    }
+    return withRotations(pageSizes, pageCount);
+}
+
+std::vector<float> DocumentFile::withRotations(const std::vector<float> &sizes, int pageCount){
+    std::vector<float> table((size_t)pageCount * 3);
+    for(int i = 0; i < pageCount; i++){
+        table[i * 3] = sizes[i * 2];
+        table[i * 3 + 1] = sizes[i * 2 + 1];
+        table[i * 3 + 2] = -1;
+    }
+    for(auto &entry : openPages){
+        if(entry.second >= 0 && entry.second < pageCount){
+            table[entry.second * 3 + 2] = (float)FPDFPage_GetRotation(entry.first);
+        }
+    }
+    return table;
+}
+
+void DocumentFile::setSourceAccess(const FPDF_FILEACCESS &access){
+    sourceAccess = access;
+    fileAccess = access;
+    fileAccess.m_GetBlock = &getInstrumentedBlock;
+    fileAccess.m_Param = this;
+    ioStats.setFileSize(access.m_FileLen);
+}
+
+int DocumentFile::getInstrumentedBlock(void *param, unsigned long position, unsigned char *outBuffer,
+                                       unsigned long size){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(param);
+    int64_t start = nowNanos();
+    int result = doc->sourceAccess.m_GetBlock(doc->sourceAccess.m_Param, position, outBuffer, size);
+    doc->ioStats.record(position, size, nowNanos() - start, result != 0);
+    return result;
+}
+
+static FPDF_BOOL isDataAlwaysAvail(FX_FILEAVAIL*, size_t, size_t){ return 1; }
+static void ignoreDownloadHint(FX_DOWNLOADHINTS*, size_t, size_t){}
+
+FPDF_DOCUMENT DocumentFile::load(const FPDF_FILEACCESS &access, const char *password){
+    setSourceAccess(access);
+    //Kept for checkForm, which parses the document again
+    this->password = password != NULL ? password : "";
+    return FPDF_LoadCustomDocument(&fileAccess, password);
+}
+
+//Whether catalog has an AcroForm is told only by the availability provider
+//(FPDF_HasXFAField is not built into our PDFium), which walks the file and parses it once
+//more. So it is asked once, on first form render, rather than on every open.
+bool DocumentFile::checkForm(){
+    if(formChecked) return hasForm;
+    formChecked = true;
+    if(progressive != NULL) return hasForm;
+
+    CountedMutex::Autolock engine(sEngineLock);
+    fileAvail.version = 1;
+    fileAvail.IsDataAvail = &isDataAlwaysAvail;
+    FX_DOWNLOADHINTS hints;
+    hints.version = 1;
+    hints.AddSegment = &ignoreDownloadHint;
+
+    FPDF_AVAIL formAvail = FPDFAvail_Create(&fileAvail, &fileAccess);
+    if(formAvail == NULL) return hasForm;
+    if(FPDFAvail_IsDocAvail(formAvail, &hints) == PDF_DATA_AVAIL){
+        FPDF_DOCUMENT document = FPDFAvail_GetDocument(formAvail, password.c_str());
+        if(document != NULL){
+            hasForm = FPDFAvail_IsFormAvail(formAvail, &hints) != PDF_FORM_NOTEXIST;
+            FPDF_CloseDocument(document);
+        }
+    }
+    FPDFAvail_Destroy(formAvail);
+    LOGD("Document %s", hasForm ? "has form" : "is form-free");
+    return hasForm;
+}
+
+bool DocumentFile::startProgressive(ProgressiveSource *source){
+    progressive = source;
+    setSourceAccess(source->getFileAccess());
+    avail = FPDFAvail_Create(source->getFileAvail(), &fileAccess);
+    return avail != NULL;
+}
+
+int DocumentFile::isDocumentAvailable(){
+    if(pdfDocument != NULL) return PDF_DATA_AVAIL;
+    return FPDFAvail_IsDocAvail(avail, progressive->getDownloadHints());
+}
+
+FPDF_DOCUMENT DocumentFile::loadAvailable(const char *password){
+    FPDF_DOCUMENT document = FPDFAvail_GetDocument(avail, password);
+    if(document != NULL){
+        //Form dictionary may still be missing, then the form is assumed present
+        hasForm = FPDFAvail_IsFormAvail(avail, progressive->getDownloadHints()) != PDF_FORM_NOTEXIST;
+        formChecked = true;
+        LOGD("Progressive document loaded with %llu of %llu bytes",
+             (unsigned long long)progressive->getAvailableBytes(),
+             (unsigned long long)progressive->getFileSize());
+    }
+    return document;
+}
+
+int DocumentFile::isPageAvailable(int pageIndex){
+    return FPDFAvail_IsPageAvail(avail, pageIndex, progressive->getDownloadHints());
+}
+
+int DocumentFile::getFirstPageNum(){
+    return pdfDocument != NULL ? FPDFAvail_GetFirstPageNum(pdfDocument) : 0;
+}
+
 DocumentFile::~DocumentFile(){
-    if(pdfDocument != NULL){
-        FPDF_CloseDocument(pdfDocument);
+    sRenderCache.removeDocument(this);
+
+    //PDFium objects are released under the engine lock, the library below without it
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        if(m_form != NULL){
+            for(FPDF_PAGE page : formPages){
+                FORM_OnBeforeClosePage(page, m_form);
+            }
+            formPages.clear();
+            FPDFDOC_ExitFormFillEnvironment(m_form);
+        }
+
+        if(pdfDocument != NULL){
+            FPDF_CloseDocument(pdfDocument);
+        }
+        if(avail != NULL){
+            FPDFAvail_Destroy(avail);
+        }
+    }
+    delete progressive;
+    delete blockCache;
+    if(ownedFd >= 0){
+        close(ownedFd);
+    }
+    if(memoryMapped){
+        munmap((void*)memoryData, memorySize);
+    }else if(memoryOwned){
+        free((void*)memoryData);
     }
 
     destroyLibraryIfNeed();
 }
 
-template <class string_type>
-inline typename string_type::value_type* WriteInto(string_type* str, size_t length_with_null) {
-  str->reserve(length_with_null);
-  str->resize(length_with_null - 1);
-  return &((*str)[0]);
-}
+/**
+ * Documents opened from files, keyed by file identity and password. Opening a file which
+ * is already open hands out another reference to the parsed document. A few documents
+ * whose last reference was released are retained, so reopening them is instant too;
+ * the least recently released ones are deleted first.
+ */
+class DocumentRegistry {
+    public:
+    DocumentRegistry() : maxRetained(1) {}
+
+    //Returns referenced document or NULL
+    DocumentFile* acquire(const FileIdentity &identity, const std::string &password){
+        Mutex::Autolock autolock(lock);
+        std::map<FileIdentity, DocumentFile*>::iterator it = documents.find(identity);
+        if(it == documents.end() || it->second->password != password) return NULL;
+
+        DocumentFile *doc = it->second;
+        if(doc->references++ == 0){
+            retained.remove(doc);
+        }
+        LOGD("Shared document, %d references", doc->references);
+        return doc;
+    }
+
+    //Share freshly opened document, unless the same file was opened meanwhile
+    void add(const FileIdentity &identity, const std::string &password, DocumentFile *doc){
+        Mutex::Autolock autolock(lock);
+        if(documents.find(identity) != documents.end()) return;
+        doc->identity = identity;
+        doc->password = password;
+        doc->registered = true;
+        documents[identity] = doc;
+    }
+
+    //Drop a reference, document is retained or deleted when it was the last one
+    void release(DocumentFile *doc){
+        Mutex::Autolock autolock(lock);
+        if(doc->references <= 0){
+            LOGE("Document released more times than acquired");
+            return;
+        }
+        if(--doc->references > 0) return;
+
+        if(doc->registered && maxRetained > 0){
+            retained.push_front(doc);
+            trimLocked();
+        }else{
+            removeLocked(doc);
+        }
+    }
+
+    void setMaxRetained(size_t count){
+        Mutex::Autolock autolock(lock);
+        maxRetained = count;
+        trimLocked();
+    }
+
+    private:
+    Mutex lock;
+    std::map<FileIdentity, DocumentFile*> documents;
+    std::list<DocumentFile*> retained; //most recently released first
+    size_t maxRetained;
+
+    void trimLocked(){
+        while(retained.size() > maxRetained){
+            DocumentFile *doc = retained.back();
+            retained.pop_back();
+            removeLocked(doc);
+        }
+    }
+
+    void removeLocked(DocumentFile *doc){
+        if(doc->registered){
+            documents.erase(doc->identity);
+        }
+        delete doc;
+    }
+};
+
+static DocumentRegistry sDocumentRegistry;
 
 inline long getFileSize(int fd){
     struct stat file_state;
@@ -150,35 +641,62 @@ int jniThrowExceptionFmt(JNIEnv* env, const char* className, const char* fmt, ..
     va_end(args);
 }
 
-jobject NewLong(JNIEnv* env, jlong value) {
-    jclass cls = env->FindClass("java/lang/Long");
-    jmethodID methodID = env->GetMethodID(cls, "<init>", "(J)V");
-    return env->NewObject(cls, methodID, value);
+//Classes and methods natives create objects with, looked up once in JNI_OnLoad
+static struct {
+    jclass longClass;
+    jmethodID longInit;
+    jclass integerClass;
+    jmethodID integerInit;
+    jclass sizeClass;
+    jmethodID sizeInit;
+    jclass pointClass;
+    jmethodID pointInit;
+    jclass pointFClass;
+    jmethodID pointFInit;
+    jclass objectClass;
+    jclass stringClass;
+} sJni;
+
+//Global reference to class, NULL with Java exception pending on failure
+static jclass cacheClass(JNIEnv *env, const char *name){
+    jclass local = env->FindClass(name);
+    if(local == NULL) {
+        LOGE("Unable to find class %s", name);
+        return NULL;
+    }
+    jclass clazz = (jclass) env->NewGlobalRef(local);
+    env->DeleteLocalRef(local);
+    return clazz;
 }
 
-jobject NewInteger(JNIEnv* env, jint value) {
-    jclass cls = env->FindClass("java/lang/Integer");
-    jmethodID methodID = env->GetMethodID(cls, "<init>", "(I)V");
-    return env->NewObject(cls, methodID, value);
+//Global reference to class and its constructor, false with Java exception pending on failure
+static bool cacheClass(JNIEnv *env, const char *name, const char *constructor,
+                       jclass *clazz, jmethodID *init){
+    *clazz = cacheClass(env, name);
+    if(*clazz == NULL) return false;
+    *init = env->GetMethodID(*clazz, "<init>", constructor);
+    return *init != NULL;
 }
 
-uint16_t rgbTo565(rgb *color) {
-    return ((color->red >> 3) << 11) | ((color->green >> 2) << 5) | (color->blue >> 3);
+static bool cacheClasses(JNIEnv *env){
+    if(!cacheClass(env, "java/lang/Long", "(J)V", &sJni.longClass, &sJni.longInit) ||
+       !cacheClass(env, "java/lang/Integer", "(I)V", &sJni.integerClass, &sJni.integerInit) ||
+       !cacheClass(env, "com/shockwave/pdfium/util/Size", "(II)V", &sJni.sizeClass, &sJni.sizeInit) ||
+       !cacheClass(env, "android/graphics/Point", "(II)V", &sJni.pointClass, &sJni.pointInit) ||
+       !cacheClass(env, "android/graphics/PointF", "(FF)V", &sJni.pointFClass, &sJni.pointFInit)) {
+        return false;
+    }
+    sJni.objectClass = cacheClass(env, "java/lang/Object");
+    sJni.stringClass = cacheClass(env, "java/lang/String");
+    return sJni.objectClass != NULL && sJni.stringClass != NULL;
 }
 
-void rgbBitmapTo565(void *source, int sourceStride, void *dest, AndroidBitmapInfo *info) {
-    rgb *srcLine;
-    uint16_t *dstLine;
-    int y, x;
-    for (y = 0; y < info->height; y++) {
-        srcLine = (rgb*) source;
-        dstLine = (uint16_t*) dest;
-        for (x = 0; x < info->width; x++) {
-            dstLine[x] = rgbTo565(&srcLine[x]);
-        }
-        source = (char*) source + sourceStride;
-        dest = (char*) dest + info->stride;
-    }
+jobject NewLong(JNIEnv* env, jlong value) {
+    return env->NewObject(sJni.longClass, sJni.longInit, value);
+}
+
+jobject NewInteger(JNIEnv* env, jint value) {
+    return env->NewObject(sJni.integerClass, sJni.integerInit, value);
 }
 
 extern "C" { //For JNI support
@@ -189,166 +707,380 @@ int PDFForm_Alert(IPDF_JSPLATFORM*, FPDF_WIDESTRING, FPDF_WIDESTRING, int, int)
   return 0;
 }
 
-void changeBitmapBR(AndroidBitmapInfo info, void * pixels){
-  int x = 0, y = 0;
-      // From top to bottom
-      for (y = 0; y < info.height; ++y) {
-          // From left to right
-          for (x = 0; x < info.width; ++x) {
-              int a = 0, r = 0, g = 0, b = 0;
-              void *pixel = NULL;
-              // Get each pixel by format
-              pixel = ((uint32_t *)pixels) + y * info.width + x;
-              uint32_t v = *(uint32_t *)pixel;
-              a = RGBA_A(v);
-              r = RGBA_R(v);
-              g = RGBA_G(v);
-              b = RGBA_B(v);
-              *((uint32_t *)pixel) = MAKE_RGBA(b, g, r, a);
-          }
-      }
-}
-
-
-bool PDFForm_Render(DocumentFile *docFile)
-{
-    IPDF_JSPLATFORM platform_callbacks;
-    FPDF_FORMFILLINFO form_callbacks;
+static int getBlock(void* param, unsigned long position, unsigned char* outBuffer,
+        unsigned long size) {
+    BlockCache *cache = reinterpret_cast<BlockCache*>(param);
+    return cache->read(position, outBuffer, size) ? 1 : 0;
+}
 
+static int getMemoryBlock(void* param, unsigned long position, unsigned char* outBuffer,
+        unsigned long size) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(param);
+    if (position > doc->memorySize || size > doc->memorySize - position) {
+        LOGE("Read of %lu bytes at %lu is past end of document data", size, position);
+        return 0;
+    }
+    memcpy(outBuffer, doc->memoryData + position, size);
+    return 1;
+}
 
-    memset(&platform_callbacks, '\0', sizeof(platform_callbacks));
-  	platform_callbacks.version = 1;
-  	platform_callbacks.app_alert = PDFForm_Alert;
+//Error is read with FPDF_GetLastError under the engine lock, right after the failed load
+static void throwLoadError(JNIEnv *env, long errorNum){
+    if(errorNum == FPDF_ERR_PASSWORD) {
+        jniThrowException(env, "com/shockwave/pdfium/PdfPasswordException",
+                                "Password required or incorrect password.");
+    } else {
+        char* error = getErrorDescription(errorNum);
+        jniThrowExceptionFmt(env, "java/io/IOException",
+                                "cannot create document: %s", error);
 
+        free(error);
+    }
+}
 
-  	memset(&form_callbacks, '\0', sizeof(form_callbacks));
-  	form_callbacks.version = 1;
-  	form_callbacks.m_pJsPlatform = &platform_callbacks;
-  	docFile->m_form = FPDFDOC_InitFormFillEnvironment(docFile->pdfDocument, &form_callbacks);
-  	if(docFile->m_form == NULL)
-  		return false;
+//Load document through given loader, on failure docFile is deleted and Java exception thrown
+static jlong openDocumentInternal(JNIEnv *env, DocumentFile *docFile, const FPDF_FILEACCESS &loader,
+                                  jstring password){
+    const char *cpassword = NULL;
+    if(password != NULL) {
+        cpassword = env->GetStringUTFChars(password, NULL);
+    }
 
-  	FPDF_SetFormFieldHighlightColor(docFile->m_form, 0, 0xFFFFFF);
-  	FPDF_SetFormFieldHighlightAlpha(docFile->m_form, 100);
-  	FORM_DoDocumentJSAction(docFile->m_form);
-  	FORM_DoDocumentOpenAction(docFile->m_form);
-    LOGE("%s", "add form");
-    return true;
+    FPDF_DOCUMENT document;
+    long error = FPDF_ERR_SUCCESS;
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        document = docFile->load(loader, cpassword);
+        if(document == NULL) error = FPDF_GetLastError();
+    }
 
-}
+    if(cpassword != NULL) {
+        env->ReleaseStringUTFChars(password, cpassword);
+    }
 
-static int getBlock(void* param, unsigned long position, unsigned char* outBuffer,
-        unsigned long size) {
-    const int fd = reinterpret_cast<intptr_t>(param);
-    const int readCount = pread(fd, outBuffer, size, position);
-    if (readCount < 0) {
-        LOGE("Cannot read from file descriptor. Error:%d", errno);
-        return 0;
+    if (!document) {
+        delete docFile;
+        throwLoadError(env, error);
+        return -1;
     }
-    return 1;
+
+    docFile->pdfDocument = document;
+    //Pages are then visited in any order
+    docFile->adviseAccess(MADV_RANDOM);
+
+    return reinterpret_cast<jlong>(docFile);
 }
 
-JNI_FUNC(jlong, PdfiumCore, nativeOpenDocument)(JNI_ARGS, jint fd, jstring password){
+//Serve document from its bytes in memory
+static jlong openMemoryDocumentInternal(JNIEnv *env, DocumentFile *docFile, jstring password){
+    FPDF_FILEACCESS loader;
+    loader.m_FileLen = docFile->memorySize;
+    loader.m_Param = docFile;
+    loader.m_GetBlock = &getMemoryBlock;
 
-    size_t fileLength = (size_t)getFileSize(fd);
-    if(fileLength <= 0) {
-        jniThrowException(env, "java/io/IOException",
-                                    "File is empty");
-        return -1;
+    if(sDiskTileCache.isOpen()) {
+        docFile->fingerprint = fingerprintMemory(docFile->memoryData, docFile->memorySize);
     }
+    return openDocumentInternal(env, docFile, loader, password);
+}
 
+//Open document reading from fd, which it then owns
+static jlong openFileDocumentInternal(JNIEnv *env, int fd, size_t fileLength, jstring password,
+                                      bool mapped){
     DocumentFile *docFile = new DocumentFile();
+    docFile->ownedFd = fd;
+
+    if(mapped) {
+        void *data = mmap(NULL, fileLength, PROT_READ, MAP_SHARED, fd, 0);
+        if(data != MAP_FAILED) {
+            docFile->memoryData = (const uint8_t*)data;
+            docFile->memorySize = fileLength;
+            docFile->memoryMapped = true;
+            //Parser walks cross-reference tables and object streams while loading
+            docFile->adviseAccess(MADV_SEQUENTIAL);
+            return openMemoryDocumentInternal(env, docFile, password);
+        }
+        LOGE("Cannot map file, falling back to reads: %s", strerror(errno));
+    }
 
     FPDF_FILEACCESS loader;
     loader.m_FileLen = fileLength;
-    loader.m_Param = reinterpret_cast<void*>(intptr_t(fd));
+    docFile->blockCache = new BlockCache(new FdBlockSource(fd), fileLength, sBlockCacheBudget);
+    loader.m_Param = docFile->blockCache;
     loader.m_GetBlock = &getBlock;
 
-    const char *cpassword = NULL;
-    if(password != NULL) {
-        cpassword = env->GetStringUTFChars(password, NULL);
+    if(sDiskTileCache.isOpen()) {
+        docFile->fingerprint = fingerprintFile(fd, fileLength);
     }
+    return openDocumentInternal(env, docFile, loader, password);
+}
 
-    FPDF_DOCUMENT document = FPDF_LoadCustomDocument(&loader, cpassword);
+//Unchanged file which is open or retained is not parsed again, its document is shared
+JNI_FUNC(jlong, PdfiumCore, nativeOpenDocument)(JNI_ARGS, jint fd, jstring password, jboolean mapped){
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+        jniThrowException(env, "java/io/IOException",
+                                    "File is empty");
+        return -1;
+    }
 
-    if(cpassword != NULL) {
+    FileIdentity identity;
+    identity.device = st.st_dev;
+    identity.inode = st.st_ino;
+    identity.size = st.st_size;
+    identity.mtimeSec = st.st_mtim.tv_sec;
+    identity.mtimeNsec = st.st_mtim.tv_nsec;
+
+    std::string passwordKey;
+    if(password != NULL) {
+        const char *cpassword = env->GetStringUTFChars(password, NULL);
+        if(cpassword == NULL) return -1;
+        passwordKey = cpassword;
         env->ReleaseStringUTFChars(password, cpassword);
     }
 
-    if (!document) {
-        delete docFile;
+    DocumentFile *shared = sDocumentRegistry.acquire(identity, passwordKey);
+    if(shared != NULL) {
+        return reinterpret_cast<jlong>(shared);
+    }
 
-        const long errorNum = FPDF_GetLastError();
-        if(errorNum == FPDF_ERR_PASSWORD) {
-            jniThrowException(env, "com/shockwave/pdfium/PdfPasswordException",
-                                    "Password required or incorrect password.");
-        } else {
-            char* error = getErrorDescription(errorNum);
-            jniThrowExceptionFmt(env, "java/io/IOException",
-                                    "cannot create document: %s", error);
+    //Caller closes its descriptor when its handle is closed, the shared document needs its own
+    int ownedFd = dup(fd);
+    if(ownedFd < 0) {
+        jniThrowExceptionFmt(env, "java/io/IOException",
+                                "cannot duplicate file descriptor: %s", strerror(errno));
+        return -1;
+    }
+    fcntl(ownedFd, F_SETFD, FD_CLOEXEC);
 
-            free(error);
-        }
+    jlong docPtr = openFileDocumentInternal(env, ownedFd, (size_t)st.st_size, password, mapped);
+    if(docPtr != -1) {
+        sDocumentRegistry.add(identity, passwordKey, reinterpret_cast<DocumentFile*>(docPtr));
+    }
+    return docPtr;
+}
 
+//Reads go to Java source in aligned chunks through the block cache. No fingerprint, so pages
+//of such documents, which may come from encrypted storage, are never written to disk cache.
+JNI_FUNC(jlong, PdfiumCore, nativeOpenSourceDocument)(JNI_ARGS, jobject source, jlong size,
+                                                      jstring password){
+    if(size <= 0) {
+        jniThrowException(env, "java/io/IOException", "File is empty");
+        return -1;
+    }
+    JavaBlockSource *javaSource = JavaBlockSource::create(env, source);
+    if(javaSource == NULL) {
         return -1;
     }
 
-    docFile->pdfDocument = document;
+    DocumentFile *docFile = new DocumentFile();
+    docFile->fileSize = (size_t)size;
+    docFile->blockCache = new BlockCache(javaSource, (uint64_t)size, sBlockCacheBudget,
+                                         JAVA_SOURCE_MIN_READ_BLOCKS);
+
+    //Loading runs under the engine lock, fetch what it reads first before taking it: the
+    //whole document when it fits in the cache, else the header and trailer chunks. A failed
+    //read here is left for the load to retry and report.
+    uint64_t fileSize = (uint64_t)size;
+    size_t chunk = JAVA_SOURCE_MIN_READ_BLOCKS * BLOCK_CACHE_BLOCK_SIZE;
+    if(fileSize <= sBlockCacheBudget / 2) {
+        docFile->blockCache->prefill(0, (size_t)fileSize);
+    } else {
+        docFile->blockCache->prefill(0, chunk);
+        docFile->blockCache->prefill(fileSize > chunk ? fileSize - chunk : 0, chunk);
+    }
 
-    return reinterpret_cast<jlong>(docFile);
+    FPDF_FILEACCESS loader;
+    loader.m_FileLen = (unsigned long)size;
+    loader.m_Param = docFile->blockCache;
+    loader.m_GetBlock = &getBlock;
+    return openDocumentInternal(env, docFile, loader, password);
 }
 
+//Document keeps a single copy of the array
 JNI_FUNC(jlong, PdfiumCore, nativeOpenMemDocument)(JNI_ARGS, jbyteArray data, jstring password){
+    size_t size = (size_t) env->GetArrayLength(data);
+    if(size == 0) {
+        jniThrowException(env, "java/io/IOException", "Data is empty");
+        return -1;
+    }
+    jbyte *copy = (jbyte*) malloc(size);
+    if(copy == NULL) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Cannot copy document data");
+        return -1;
+    }
+    env->GetByteArrayRegion(data, 0, (jsize)size, copy);
+
     DocumentFile *docFile = new DocumentFile();
+    docFile->memoryData = (const uint8_t*)copy;
+    docFile->memorySize = size;
+    docFile->memoryOwned = true;
+    return openMemoryDocumentInternal(env, docFile, password);
+}
 
-    const char *cpassword = NULL;
-    if(password != NULL) {
-        cpassword = env->GetStringUTFChars(password, NULL);
+//Document is read in place, Java keeps the buffer reachable while document is open
+JNI_FUNC(jlong, PdfiumCore, nativeOpenDirectBufferDocument)(JNI_ARGS, jobject buffer, jint offset, jint length,
+                                                      jstring password){
+    uint8_t *address = (uint8_t*) env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if(address == NULL || offset < 0 || length <= 0 || (jlong)offset + length > capacity) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                               "Buffer is not direct or range is invalid");
+        return -1;
     }
 
-    jbyte *cData = env->GetByteArrayElements(data, NULL);
-    int size = (int) env->GetArrayLength(data);
-    jbyte *cDataCopy = new jbyte[size];
-    memcpy(cDataCopy, cData, size);
-    FPDF_DOCUMENT document = FPDF_LoadMemDocument( reinterpret_cast<const void*>(cDataCopy),
-                                                          size, cpassword);
-    env->ReleaseByteArrayElements(data, cData, JNI_ABORT);
+    DocumentFile *docFile = new DocumentFile();
+    docFile->memoryData = address + offset;
+    docFile->memorySize = (size_t)length;
+    return openMemoryDocumentInternal(env, docFile, password);
+}
+
+//Document without data yet, it is loaded by nativeProgressiveLoad once enough data arrived
+JNI_FUNC(jlong, PdfiumCore, nativeOpenProgressiveDocument)(JNI_ARGS, jlong fileSize){
+    if(fileSize <= 0) {
+        jniThrowException(env, "java/io/IOException", "File is empty");
+        return -1;
+    }
 
-    if(cpassword != NULL) {
-        env->ReleaseStringUTFChars(password, cpassword);
+    ProgressiveSource *source = new ProgressiveSource((uint64_t)fileSize);
+    if(!source->init()) {
+        delete source;
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Cannot allocate document data");
+        return -1;
     }
 
-    if (!document) {
+    DocumentFile *docFile = new DocumentFile();
+    docFile->fileSize = (size_t)fileSize;
+    bool started;
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        started = docFile->startProgressive(source);
+    }
+    if(!started) {
         delete docFile;
+        jniThrowException(env, "java/io/IOException", "Cannot create availability provider");
+        return -1;
+    }
+    return reinterpret_cast<jlong>(docFile);
+}
 
-        const long errorNum = FPDF_GetLastError();
-        if(errorNum == FPDF_ERR_PASSWORD) {
-            jniThrowException(env, "com/shockwave/pdfium/PdfPasswordException",
-                                    "Password required or incorrect password.");
-        } else {
-            char* error = getErrorDescription(errorNum);
-            jniThrowExceptionFmt(env, "java/io/IOException",
-                                    "cannot create document: %s", error);
+//Safe to call from any thread while document is open
+JNI_FUNC(jboolean, PdfiumCore, nativeProgressiveAddData)(JNI_ARGS, jlong docPtr, jlong offset,
+                                                         jbyteArray data, jint dataOffset, jint length){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc->progressive == NULL || offset < 0 || dataOffset < 0 || length < 0 ||
+       dataOffset + length > env->GetArrayLength(data)) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "Invalid data range");
+        return JNI_FALSE;
+    }
 
-            free(error);
+    jbyte *bytes = env->GetByteArrayElements(data, NULL);
+    if(bytes == NULL) return JNI_FALSE;
+    bool added = doc->progressive->addData((uint64_t)offset, bytes + dataOffset, (size_t)length);
+    env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+    return (jboolean)added;
+}
+
+//Ranges the library asked for since last call, as [offset, size] pairs
+JNI_FUNC(jlongArray, PdfiumCore, nativeProgressiveGetRequests)(JNI_ARGS, jlong docPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc->progressive == NULL) return NULL;
+
+    std::vector<ByteRange> requests = doc->progressive->takeRequests();
+    std::vector<jlong> values;
+    values.reserve(requests.size() * 2);
+    for(size_t i = 0; i < requests.size(); i++) {
+        values.push_back((jlong)requests[i].offset);
+        values.push_back((jlong)requests[i].size);
+    }
+    jlongArray result = env->NewLongArray((jsize)values.size());
+    if(result == NULL) return NULL;
+    if(!values.empty()) {
+        env->SetLongArrayRegion(result, 0, (jsize)values.size(), &values[0]);
+    }
+    return result;
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeProgressiveGetAvailableBytes)(JNI_ARGS, jlong docPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc->progressive == NULL) return (jlong)doc->fileSize;
+    return (jlong)doc->progressive->getAvailableBytes();
+}
+
+//Returns PDF_DATA_* status, document is loaded when it becomes available
+JNI_FUNC(jint, PdfiumCore, nativeProgressiveLoad)(JNI_ARGS, jlong docPtr, jstring password){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    CountedMutex::Autolock documentLock(doc->lock);
+    if(doc->progressive == NULL || doc->pdfDocument != NULL) return PDF_DATA_AVAIL;
+
+    const char *cpassword = NULL;
+    if(password != NULL) {
+        cpassword = env->GetStringUTFChars(password, NULL);
+    }
+    int status;
+    FPDF_DOCUMENT document = NULL;
+    long error = FPDF_ERR_SUCCESS;
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        status = doc->isDocumentAvailable();
+        if(status == PDF_DATA_AVAIL) {
+            document = doc->loadAvailable(cpassword);
+            if(document == NULL) error = FPDF_GetLastError();
         }
+    }
+    if(cpassword != NULL) {
+        env->ReleaseStringUTFChars(password, cpassword);
+    }
+    if(status != PDF_DATA_AVAIL) return status;
 
-        return -1;
+    if(document == NULL) {
+        //Document stays open for the caller to close
+        throwLoadError(env, error);
+        return PDF_DATA_ERROR;
     }
+    doc->pdfDocument = document;
+    return PDF_DATA_AVAIL;
+}
 
-    docFile->pdfDocument = document;
+JNI_FUNC(jint, PdfiumCore, nativeProgressiveIsPageAvail)(JNI_ARGS, jlong docPtr, jint pageIndex){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    CountedMutex::Autolock documentLock(doc->lock);
+    CountedMutex::Autolock engine(sEngineLock);
+    if(doc->progressive == NULL) return PDF_DATA_AVAIL;
+    if(doc->pdfDocument == NULL) return PDF_DATA_NOTAVAIL;
+    return doc->isPageAvailable(pageIndex);
+}
 
-    return reinterpret_cast<jlong>(docFile);
+//First page of linearized document, which is available first; 0 otherwise
+JNI_FUNC(jint, PdfiumCore, nativeProgressiveGetFirstPage)(JNI_ARGS, jlong docPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    CountedMutex::Autolock documentLock(doc->lock);
+    CountedMutex::Autolock engine(sEngineLock);
+    if(doc->progressive == NULL) return 0;
+    return doc->getFirstPageNum();
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeHasForm)(JNI_ARGS, jlong documentPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(documentPtr);
+    CountedMutex::Autolock documentLock(doc->lock);
+    return (jboolean)doc->checkForm();
 }
 
 JNI_FUNC(jint, PdfiumCore, nativeGetPageCount)(JNI_ARGS, jlong documentPtr){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(documentPtr);
+    CountedMutex::Autolock documentLock(doc->lock);
+    CountedMutex::Autolock engine(sEngineLock);
     return (jint)FPDF_GetPageCount(doc->pdfDocument);
 }
 
+//Document is deleted with the engine lock when its last handle is closed, see ~DocumentFile
 JNI_FUNC(void, PdfiumCore, nativeCloseDocument)(JNI_ARGS, jlong documentPtr){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(documentPtr);
-    delete doc;
+    sDocumentRegistry.release(doc);
+}
+
+JNI_FUNC(void, PdfiumCore, nativeSetRetainedDocuments)(JNI_ARGS, jint count){
+    sDocumentRegistry.setMaxRetained(count > 0 ? (size_t)count : 0);
 }
 
 static jlong loadPageInternal(JNIEnv *env, DocumentFile *doc, int pageIndex){
@@ -357,7 +1089,7 @@ static jlong loadPageInternal(JNIEnv *env, DocumentFile *doc, int pageIndex){
 
         FPDF_DOCUMENT pdfDoc = doc->pdfDocument;
         if(pdfDoc != NULL){
-            FPDF_PAGE page = FPDF_LoadPage(pdfDoc, pageIndex);
+            FPDF_PAGE page = doc->loadPage(pageIndex);
             if (page == NULL) {
                 throw "Loaded page is null";
             }
@@ -376,10 +1108,19 @@ static jlong loadPageInternal(JNIEnv *env, DocumentFile *doc, int pageIndex){
     }
 }
 
-static void closePageInternal(jlong pagePtr) { FPDF_ClosePage(reinterpret_cast<FPDF_PAGE>(pagePtr)); }
+static void closePageInternal(DocumentFile *doc, jlong pagePtr) {
+    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if(doc != NULL) {
+        doc->closePage(page);
+    } else {
+        FPDF_ClosePage(page);
+    }
+}
 
 JNI_FUNC(jlong, PdfiumCore, nativeLoadPage)(JNI_ARGS, jlong docPtr, jint pageIndex){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    CountedMutex::Autolock documentLock(doc->lock);
+    CountedMutex::Autolock engine(sEngineLock);
     return loadPageInternal(env, doc, (int)pageIndex);
 }
 JNI_FUNC(jlongArray, PdfiumCore, nativeLoadPages)(JNI_ARGS, jlong docPtr, jint fromIndex, jint toIndex){
@@ -388,6 +1129,8 @@ JNI_FUNC(jlongArray, PdfiumCore, nativeLoadPages)(JNI_ARGS, jlong docPtr, jint f
     if(toIndex < fromIndex) return NULL;
     jlong pages[ toIndex - fromIndex + 1 ];
 
+    CountedMutex::Autolock documentLock(doc->lock);
+    CountedMutex::Autolock engine(sEngineLock);
     int i;
     for(i = 0; i <= (toIndex - fromIndex); i++){
         pages[i] = loadPageInternal(env, doc, (int)(i + fromIndex));
@@ -399,30 +1142,45 @@ JNI_FUNC(jlongArray, PdfiumCore, nativeLoadPages)(JNI_ARGS, jlong docPtr, jint f
     return javaPages;
 }
 
-JNI_FUNC(void, PdfiumCore, nativeClosePage)(JNI_ARGS, jlong pagePtr){ closePageInternal(pagePtr); }
-JNI_FUNC(void, PdfiumCore, nativeClosePages)(JNI_ARGS, jlongArray pagesPtr){
+JNI_FUNC(void, PdfiumCore, nativeClosePage)(JNI_ARGS, jlong docPtr, jlong pagePtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    CountedMutex::Autolock documentLock(doc->lock);
+    CountedMutex::Autolock engine(sEngineLock);
+    closePageInternal(doc, pagePtr);
+}
+JNI_FUNC(void, PdfiumCore, nativeClosePages)(JNI_ARGS, jlong docPtr, jlongArray pagesPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
     int length = (int)(env -> GetArrayLength(pagesPtr));
     jlong *pages = env -> GetLongArrayElements(pagesPtr, NULL);
 
-    int i;
-    for(i = 0; i < length; i++){ closePageInternal(pages[i]); }
+    {
+        CountedMutex::Autolock documentLock(doc->lock);
+        CountedMutex::Autolock engine(sEngineLock);
+        int i;
+        for(i = 0; i < length; i++){ closePageInternal(doc, pages[i]); }
+    }
+    env -> ReleaseLongArrayElements(pagesPtr, pages, JNI_ABORT);
 }
 
 JNI_FUNC(jint, PdfiumCore, nativeGetPageWidthPixel)(JNI_ARGS, jlong pagePtr, jint dpi){
     FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     return (jint)(FPDF_GetPageWidth(page) * dpi / 72);
 }
 JNI_FUNC(jint, PdfiumCore, nativeGetPageHeightPixel)(JNI_ARGS, jlong pagePtr, jint dpi){
     FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     return (jint)(FPDF_GetPageHeight(page) * dpi / 72);
 }
 
 JNI_FUNC(jint, PdfiumCore, nativeGetPageWidthPoint)(JNI_ARGS, jlong pagePtr){
     FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     return (jint)FPDF_GetPageWidth(page);
 }
 JNI_FUNC(jint, PdfiumCore, nativeGetPageHeightPoint)(JNI_ARGS, jlong pagePtr){
     FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     return (jint)FPDF_GetPageHeight(page);
 }
 JNI_FUNC(jobject, PdfiumCore, nativeGetPageSizeByIndex)(JNI_ARGS, jlong docPtr, jint pageIndex, jint dpi){
@@ -436,7 +1194,12 @@ JNI_FUNC(jobject, PdfiumCore, nativeGetPageSizeByIndex)(JNI_ARGS, jlong docPtr,
     }
 
     double width, height;
-    int result = FPDF_GetPageSizeByIndex(doc->pdfDocument, pageIndex, &width, &height);
+    int result;
+    {
+        CountedMutex::Autolock documentLock(doc->lock);
+        CountedMutex::Autolock engine(sEngineLock);
+        result = FPDF_GetPageSizeByIndex(doc->pdfDocument, pageIndex, &width, &height);
+    }
 
     if (result == 0) {
         width = 0;
@@ -446,9 +1209,25 @@ JNI_FUNC(jobject, PdfiumCore, nativeGetPageSizeByIndex)(JNI_ARGS, jlong docPtr,
     jint widthInt = (jint) (width * dpi / 72);
     jint heightInt = (jint) (height * dpi / 72);
 
-    jclass clazz = env->FindClass("com/shockwave/pdfium/util/Size");
-    jmethodID constructorID = env->GetMethodID(clazz, "<init>", "(II)V");
-    return env->NewObject(clazz, constructorID, widthInt, heightInt);
+    return env->NewObject(sJni.sizeClass, sJni.sizeInit, widthInt, heightInt);
+}
+
+//[width, height, rotation] per page, sizes in points, rotation in quarter turns or -1 if page is not loaded
+JNI_FUNC(jfloatArray, PdfiumCore, nativeGetAllPageSizes)(JNI_ARGS, jlong docPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    std::vector<float> table;
+    {
+        CountedMutex::Autolock documentLock(doc->lock);
+        CountedMutex::Autolock engine(sEngineLock);
+        table = doc->getPageSizes();
+    }
+
+    jfloatArray result = env->NewFloatArray((jsize)table.size());
+    if(result == NULL) return NULL;
+    if(!table.empty()) {
+        env->SetFloatArrayRegion(result, 0, (jsize)table.size(), &table[0]);
+    }
+    return result;
 }
 
 static void renderPageInternal( FPDF_PAGE page,
@@ -524,317 +1303,1052 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPage)(JNI_ARGS, jlong pagePtr, jobject ob
         return;
     }
 
-    renderPageInternal(page, &buffer,
-                       (int)startX, (int)startY,
-                       buffer.width, buffer.height,
-                       (int)drawSizeHor, (int)drawSizeVer,
-                       (bool)renderAnnot);
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        renderPageInternal(page, &buffer,
+                           (int)startX, (int)startY,
+                           buffer.width, buffer.height,
+                           (int)drawSizeHor, (int)drawSizeVer,
+                           (bool)renderAnnot);
+    }
 
     ANativeWindow_unlockAndPost(nativeWindow);
     ANativeWindow_release(nativeWindow);
 }
 
-/*
-JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong pagePtr, jobject bitmap,
-                                             jint dpi, jint startX, jint startY,
+//Paint page area white and the rest of canvas gray
+static void fillPageBackground(FPDF_BITMAP pdfBitmap, int canvasHorSize, int canvasVerSize,
+                               int startX, int startY, int drawSizeHor, int drawSizeVer){
+    //Part of canvas covered by page, start may be negative when rendering fragments of zoomed page
+    int baseX = (startX < 0)? 0 : startX;
+    int baseY = (startY < 0)? 0 : startY;
+    int baseHorSize = ((startX + drawSizeHor < canvasHorSize)? startX + drawSizeHor : canvasHorSize) - baseX;
+    int baseVerSize = ((startY + drawSizeVer < canvasVerSize)? startY + drawSizeVer : canvasVerSize) - baseY;
+
+    if(baseX > 0 || baseY > 0 || baseX + baseHorSize < canvasHorSize || baseY + baseVerSize < canvasVerSize){
+        FPDFBitmap_FillRect( pdfBitmap, 0, 0, canvasHorSize, canvasVerSize,
+                             0x848484FF); //Gray
+    }
+
+    if(baseHorSize > 0 && baseVerSize > 0) {
+        FPDFBitmap_FillRect( pdfBitmap, baseX, baseY, baseHorSize, baseVerSize,
+                             0xFFFFFFFF); //White
+    }
+}
+
+static int renderCacheFlags(bool renderAnnot, bool renderForm, bool dither, int format){
+    return (renderAnnot ? 1 : 0) | (renderForm ? 2 : 0) | (dither ? 4 : 0) | (format << 8);
+}
+
+static void toDiskCacheKey(const RenderCacheKey &key, uint64_t fingerprint, DiskCacheKey *diskKey){
+    memset(diskKey, 0, sizeof(DiskCacheKey));
+    diskKey->fingerprint = fingerprint;
+    diskKey->pageIndex = key.pageIndex;
+    diskKey->flags = key.flags;
+    diskKey->drawWidth = key.drawWidth;
+    diskKey->drawHeight = key.drawHeight;
+    diskKey->startX = key.startX;
+    diskKey->startY = key.startY;
+    diskKey->width = key.width;
+    diskKey->height = key.height;
+}
+
+//Fill pixels from render cache, or from disk cache for documents which have a fingerprint.
+//Called with the document lock held.
+static bool readCachedRender(DocumentFile *doc, const RenderCacheKey &key,
+                             void *addr, int stride, int rowBytes){
+    RenderStats &stats = doc->renderStats;
+    if(sRenderCache.get(key, addr, stride, rowBytes)) {
+        stats.cacheHits++;
+        return true;
+    }
+    stats.cacheMisses++;
+
+    if(doc->fingerprint != 0) {
+        DiskCacheKey diskKey;
+        toDiskCacheKey(key, doc->fingerprint, &diskKey);
+        if(sDiskTileCache.get(diskKey, addr, stride, rowBytes)) {
+            sRenderCache.put(key, addr, stride, rowBytes);
+            stats.diskCacheHits++;
+            return true;
+        }
+        stats.diskCacheMisses++;
+    }
+    return false;
+}
+
+static void storeCachedRender(DocumentFile *doc, const RenderCacheKey &key,
+                              const void *addr, int stride, int rowBytes){
+    sRenderCache.put(key, addr, stride, rowBytes);
+    if(doc->fingerprint != 0) {
+        DiskCacheKey diskKey;
+        toDiskCacheKey(key, doc->fingerprint, &diskKey);
+        sDiskTileCache.put(diskKey, addr, stride, rowBytes);
+    }
+}
+
+static void renderPageBitmapInternal(JNIEnv *env, DocumentFile *doc, FPDF_PAGE page, int pageIndex,
+                                     jobject bitmap, int startX, int startY,
+                                     int drawSizeHor, int drawSizeVer,
+                                     bool renderAnnot, bool renderForm, bool dither){
+    if(doc == NULL || page == NULL || bitmap == NULL){
+        LOGE("Render page pointers invalid");
+        return;
+    }
+    CountedMutex::Autolock documentLock(doc->lock);
+
+    AndroidBitmapInfo info;
+    int ret;
+    if((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
+        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+        return;
+    }
+
+    int canvasHorSize = info.width;
+    int canvasVerSize = info.height;
+
+    if(info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 && info.format != ANDROID_BITMAP_FORMAT_RGB_565){
+        LOGE("Bitmap format must be RGBA_8888 or RGB_565");
+        return;
+    }
+
+    RenderStats &stats = doc->renderStats;
+    int64_t stageStart = nowNanos();
+
+    if(renderForm && !doc->checkForm()) {
+        renderForm = false;
+        stats.formSkipCount++;
+    }
+
+    void *addr;
+    if( (ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0 ){
+        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+        return;
+    }
+
+    RenderCacheKey cacheKey;
+    cacheKey.document = doc;
+    cacheKey.pageIndex = pageIndex;
+    cacheKey.flags = renderCacheFlags(renderAnnot, renderForm, dither, info.format);
+    cacheKey.drawWidth = drawSizeHor;
+    cacheKey.drawHeight = drawSizeVer;
+    cacheKey.startX = startX;
+    cacheKey.startY = startY;
+    cacheKey.width = canvasHorSize;
+    cacheKey.height = canvasVerSize;
+    int rowBytes = canvasHorSize * (info.format == ANDROID_BITMAP_FORMAT_RGB_565 ? 2 : 4);
+
+    if(readCachedRender(doc, cacheKey, addr, info.stride, rowBytes)) {
+        AndroidBitmap_unlockPixels(env, bitmap);
+        stats.stageNanos[RENDER_STAGE_LOCK] += nowNanos() - stageStart;
+        return;
+    }
+
+    //Page content and form widgets are both drawn in the engine's native BGR(A) order,
+    //then converted exactly once into the bitmap format
+    void *tmp;
+    int format;
+    int sourceStride;
+    if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
+        //24-bit BGR, converted into the bitmap afterwards
+        sourceStride = canvasHorSize * 3;
+        tmp = acquireScratchBuffer((size_t)canvasVerSize * sourceStride);
+        if (tmp == NULL) {
+            LOGE("Cannot allocate RGB_565 conversion buffer");
+            AndroidBitmap_unlockPixels(env, bitmap);
+            return;
+        }
+        format = FPDFBitmap_BGR;
+    } else {
+        tmp = addr;
+        sourceStride = info.stride;
+        format = FPDFBitmap_BGRA;
+    }
+
+    FPDF_BITMAP pdfBitmap;
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        pdfBitmap = FPDFBitmap_CreateEx( canvasHorSize, canvasVerSize,
+                                         format, tmp, sourceStride);
+        fillPageBackground(pdfBitmap, canvasHorSize, canvasVerSize,
+                           startX, startY, drawSizeHor, drawSizeVer);
+    }
+
+    int64_t now = nowNanos();
+    stats.stageNanos[RENDER_STAGE_LOCK] += now - stageStart;
+    stageStart = now;
+
+    int flags = 0;
+
+    if(renderAnnot) {
+    	flags |= FPDF_ANNOT;
+    }
+
+    //Without form widgets PDFium can write RGBA itself, so no conversion pass is needed.
+    //FPDF_FFLDraw ignores FPDF_REVERSE_BYTE_ORDER, so with forms everything stays in native order.
+    bool needsConversion = renderForm || info.format == ANDROID_BITMAP_FORMAT_RGB_565;
+    if(!needsConversion) {
+        flags |= FPDF_REVERSE_BYTE_ORDER;
+    }
+
+    //Rendered in slices, calls for other documents get the engine in between
+    RenderJob *job = new RenderJob(page, pdfBitmap);
+    int status;
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        status = job->start(startX, startY, drawSizeHor, drawSizeVer, flags, RENDER_SLICE_NANOS);
+    }
+    while(status == FPDF_RENDER_TOBECOUNTINUED) {
+        CountedMutex::Autolock engine(sEngineLock);
+        status = job->resume(RENDER_SLICE_NANOS);
+    }
+    if(status != FPDF_RENDER_DONE) {
+        LOGE("Render of page %d failed", pageIndex);
+    }
+
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        delete job;
+
+        now = nowNanos();
+        stats.stageNanos[RENDER_STAGE_PAGE] += now - stageStart;
+        stageStart = now;
+
+        if(renderForm && doc->prepareFormPage(page)) {
+            FPDF_FFLDraw(doc->m_form,
+                         pdfBitmap, page,
+                         startX, startY,
+                         drawSizeHor, drawSizeVer,
+                         0, flags );
+            stats.formRenderCount++;
+
+            now = nowNanos();
+            stats.stageNanos[RENDER_STAGE_FORM] += now - stageStart;
+            stageStart = now;
+        }
+    }
+
+    if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
+        bgrTo565(tmp, sourceStride, addr, info.stride, info.width, info.height, dither);
+        stats.conversionPasses++;
+    } else if (needsConversion) {
+        swizzleRB(addr, info.width, info.height, info.stride);
+        stats.conversionPasses++;
+    }
+
+    //Failed render would otherwise be served from the caches from now on
+    if(status == FPDF_RENDER_DONE) {
+        storeCachedRender(doc, cacheKey, addr, info.stride, rowBytes);
+    }
+
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        FPDFBitmap_Destroy(pdfBitmap);
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+
+    stats.stageNanos[RENDER_STAGE_CONVERT] += nowNanos() - stageStart;
+    stats.renderCount++;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong docPtr, jlong pagePtr, jint pageIndex,
+                                             jobject bitmap, jint dpi, jint startX, jint startY,
                                              jint drawSizeHor, jint drawSizeVer,
-                                             jboolean renderAnnot){
+                                             jboolean renderAnnot, jboolean renderForm,
+                                             jboolean dither){
+    renderPageBitmapInternal(env, reinterpret_cast<DocumentFile*>(docPtr),
+                             reinterpret_cast<FPDF_PAGE>(pagePtr), (int)pageIndex, bitmap,
+                             (int)startX, (int)startY, (int)drawSizeHor, (int)drawSizeVer,
+                             (bool)renderAnnot, (bool)renderForm, (bool)dither);
+}
 
+//Page at given zoom (pixels per point) is split into a grid of tileSize x tileSize tiles,
+//tile (tileX, tileY) is drawn into top left corner of bitmap
+JNI_FUNC(void, PdfiumCore, nativeRenderPageTile)(JNI_ARGS, jlong docPtr, jlong pagePtr, jint pageIndex, jfloat zoom,
+                                             jint tileX, jint tileY, jint tileSize, jobject bitmap,
+                                             jboolean renderAnnot, jboolean renderForm,
+                                             jboolean dither){
     FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if(page == NULL || zoom <= 0 || tileSize <= 0 || tileX < 0 || tileY < 0){
+        LOGE("Render tile arguments invalid");
+        return;
+    }
 
-    if(page == NULL || bitmap == NULL){
-        LOGE("Render page pointers invalid");
+    double pageWidth, pageHeight;
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        pageWidth = FPDF_GetPageWidth(page) * zoom;
+        pageHeight = FPDF_GetPageHeight(page) * zoom;
+    }
+    double startX = -(double)tileX * tileSize;
+    double startY = -(double)tileY * tileSize;
+    if(pageWidth > INT32_MAX || pageHeight > INT32_MAX || startX < INT32_MIN || startY < INT32_MIN){
+        LOGE("Render tile zoom too large");
         return;
     }
 
+    renderPageBitmapInternal(env, reinterpret_cast<DocumentFile*>(docPtr), page, (int)pageIndex, bitmap,
+                             (int)startX, (int)startY, (int)pageWidth, (int)pageHeight,
+                             (bool)renderAnnot, (bool)renderForm, (bool)dither);
+}
+
+//Thumbnail atlas layout: [atlasWidth, atlasHeight, then x, y, width, height for every page].
+//Pages are measured with FPDF_GetPageSizeByIndex, so none of them has to be loaded.
+//Thumbnails are packed left to right into rows (shelves), about as many rows as columns.
+//Neither side exceeds maxAtlas, pages after the last row which fits are left out of the layout.
+JNI_FUNC(jintArray, PdfiumCore, nativeLayoutThumbnails)(JNI_ARGS, jlong docPtr, jint fromPage, jint toPage,
+                                                   jint maxEdge, jint maxAtlas){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc == NULL || doc->pdfDocument == NULL){
+        jniThrowException(env, "java/lang/IllegalStateException", "Document is null");
+        return NULL;
+    }
+    CountedMutex::Autolock documentLock(doc->lock);
+    CountedMutex::Autolock engine(sEngineLock);
+    int pageCount = FPDF_GetPageCount(doc->pdfDocument);
+    if(fromPage < 0 || toPage >= pageCount || toPage < fromPage || maxEdge <= 0 || maxAtlas < maxEdge){
+        jniThrowExceptionFmt(env, "java/lang/IllegalArgumentException",
+                             "Invalid thumbnail range %d-%d of %d pages, max edge %d, max atlas %d",
+                             fromPage, toPage, pageCount, maxEdge, maxAtlas);
+        return NULL;
+    }
+
+    int count = toPage - fromPage + 1;
+    int columns = 1;
+    while(columns * columns < count) columns++;
+    if(columns > maxAtlas / maxEdge) columns = maxAtlas / maxEdge;
+    int atlasWidth = columns * maxEdge;
+
+    std::vector<jint> layout(2 + count * 4);
+    int x = 0, y = 0, rowHeight = 0;
+    int laidOut = 0;
+    for(int i = 0; i < count; i++){
+        double width, height;
+        int thumbWidth = 0, thumbHeight = 0;
+        if(FPDF_GetPageSizeByIndex(doc->pdfDocument, fromPage + i, &width, &height)
+           && width > 0 && height > 0){
+            double scale = (double)maxEdge / (width > height ? width : height);
+            thumbWidth = (int)(width * scale + 0.5);
+            thumbHeight = (int)(height * scale + 0.5);
+            if(thumbWidth < 1) thumbWidth = 1;
+            if(thumbHeight < 1) thumbHeight = 1;
+        }else{
+            LOGE("Cannot get size of page %d", fromPage + i);
+        }
+
+        if(x + thumbWidth > atlasWidth){
+            x = 0;
+            y += rowHeight;
+            rowHeight = 0;
+        }
+        if(y + thumbHeight > maxAtlas){
+            break;
+        }
+        jint *rect = &layout[2 + i * 4];
+        rect[0] = x;
+        rect[1] = y;
+        rect[2] = thumbWidth;
+        rect[3] = thumbHeight;
+        x += thumbWidth;
+        if(thumbHeight > rowHeight) rowHeight = thumbHeight;
+        laidOut++;
+    }
+    layout.resize(2 + laidOut * 4);
+    layout[0] = atlasWidth;
+    layout[1] = y + rowHeight;
+
+    jintArray result = env->NewIntArray((jsize)layout.size());
+    if(result == NULL) return NULL;
+    env->SetIntArrayRegion(result, 0, (jsize)layout.size(), &layout[0]);
+    return result;
+}
+
+//Render pages straight into their rectangles of RGBA_8888 atlas bitmap, in one pass.
+//Every page is loaded only for the time of its render, forms are not drawn.
+JNI_FUNC(jint, PdfiumCore, nativeRenderThumbnails)(JNI_ARGS, jlong docPtr, jint fromPage, jint toPage,
+                                              jintArray layoutArray, jobject bitmap, jboolean renderAnnot){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc == NULL || doc->pdfDocument == NULL || bitmap == NULL || layoutArray == NULL){
+        LOGE("Render thumbnails arguments invalid");
+        return 0;
+    }
+    CountedMutex::Autolock documentLock(doc->lock);
+    int count = toPage - fromPage + 1;
+    if(count <= 0 || env->GetArrayLength(layoutArray) != 2 + count * 4){
+        LOGE("Thumbnail layout does not match page range");
+        return 0;
+    }
+
     AndroidBitmapInfo info;
     int ret;
     if((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
         LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
-        return;
+        return 0;
+    }
+    if(info.format != ANDROID_BITMAP_FORMAT_RGBA_8888){
+        LOGE("Thumbnail atlas must be RGBA_8888");
+        return 0;
     }
 
-    int canvasHorSize = info.width;
-    int canvasVerSize = info.height;
-
-    if(info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 && info.format != ANDROID_BITMAP_FORMAT_RGB_565){
-        LOGE("Bitmap format must be RGBA_8888 or RGB_565");
-        return;
+    std::vector<jint> layout(2 + count * 4);
+    env->GetIntArrayRegion(layoutArray, 0, (jsize)layout.size(), &layout[0]);
+    if(layout[0] > (jint)info.width || layout[1] > (jint)info.height){
+        LOGE("Thumbnail atlas bitmap too small");
+        return 0;
     }
 
+    RenderStats &stats = doc->renderStats;
+    int64_t stageStart = nowNanos();
+
     void *addr;
     if( (ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0 ){
         LOGE("Locking bitmap failed: %s", strerror(ret * -1));
-        return;
+        return 0;
     }
+    memset(addr, 0, (size_t)info.stride * info.height);
 
-    void *tmp;
-    int format;
-    int sourceStride;
-    if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
-        tmp = malloc(canvasVerSize * canvasHorSize * sizeof(rgb));
-        sourceStride = canvasHorSize * sizeof(rgb);
-        format = FPDFBitmap_BGR;
-    } else {
-        tmp = addr;
-        sourceStride = info.stride;
-        format = FPDFBitmap_BGRA;
+    int64_t now = nowNanos();
+    stats.stageNanos[RENDER_STAGE_LOCK] += now - stageStart;
+    stageStart = now;
+
+    int flags = FPDF_REVERSE_BYTE_ORDER;
+    if(renderAnnot) {
+        flags |= FPDF_ANNOT;
     }
 
-    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx( canvasHorSize, canvasVerSize,
-                                                     format, tmp, sourceStride);
+    //Thumbnail is a whole page render, so it shares disk cache entries with renderPageBitmap
+    DiskCacheKey diskKey;
+    memset(&diskKey, 0, sizeof(diskKey));
+    diskKey.fingerprint = doc->fingerprint;
+    diskKey.flags = renderCacheFlags(renderAnnot, false, false, ANDROID_BITMAP_FORMAT_RGBA_8888);
+
+    //Pages are visited in order
+    doc->adviseAccess(MADV_SEQUENTIAL);
+
+    int rendered = 0;
+    for(int i = 0; i < count; i++){
+        const jint *rect = &layout[2 + i * 4];
+        if(rect[2] <= 0 || rect[3] <= 0) continue;
+
+        //Bitmap wrapping thumbnail's rectangle, rows keep stride of the whole atlas
+        uint8_t *origin = (uint8_t*)addr + (size_t)rect[1] * info.stride + (size_t)rect[0] * 4;
+
+        diskKey.pageIndex = fromPage + i;
+        diskKey.drawWidth = diskKey.width = rect[2];
+        diskKey.drawHeight = diskKey.height = rect[3];
+        if(doc->fingerprint != 0) {
+            if(sDiskTileCache.get(diskKey, origin, info.stride, rect[2] * 4)) {
+                stats.diskCacheHits++;
+                rendered++;
+                continue;
+            }
+            stats.diskCacheMisses++;
+        }
 
-    if(drawSizeHor < canvasHorSize || drawSizeVer < canvasVerSize){
-        FPDFBitmap_FillRect( pdfBitmap, 0, 0, canvasHorSize, canvasVerSize,
-                             0x848484FF); //Gray
-    }
+        //Engine is taken per thumbnail, so other documents are served between them
+        {
+            CountedMutex::Autolock engine(sEngineLock);
+            FPDF_PAGE page = FPDF_LoadPage(doc->pdfDocument, fromPage + i);
+            if(page == NULL){
+                LOGE("Cannot load page %d for thumbnail", fromPage + i);
+                continue;
+            }
 
-    int baseHorSize = (canvasHorSize < drawSizeHor)? canvasHorSize : (int)drawSizeHor;
-    int baseVerSize = (canvasVerSize < drawSizeVer)? canvasVerSize : (int)drawSizeVer;
-    int baseX = (startX < 0)? 0 : (int)startX;
-    int baseY = (startY < 0)? 0 : (int)startY;
-    int flags = FPDF_REVERSE_BYTE_ORDER;
+            FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(rect[2], rect[3], FPDFBitmap_BGRA,
+                                                        origin, info.stride);
+            FPDFBitmap_FillRect(pdfBitmap, 0, 0, rect[2], rect[3], 0xFFFFFFFF);
+            FPDF_RenderPageBitmap(pdfBitmap, page, 0, 0, rect[2], rect[3], 0, flags);
+            FPDFBitmap_Destroy(pdfBitmap);
+            FPDF_ClosePage(page);
+        }
+        if(doc->fingerprint != 0) {
+            sDiskTileCache.put(diskKey, origin, info.stride, rect[2] * 4);
+        }
 
-    if(renderAnnot) {
-    	flags |= FPDF_ANNOT;
+        stats.renderCount++;
+        rendered++;
     }
 
-    FPDFBitmap_FillRect( pdfBitmap, baseX, baseY, baseHorSize, baseVerSize,
-                         0xFFFFFFFF); //White
+    doc->adviseAccess(MADV_RANDOM);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    stats.stageNanos[RENDER_STAGE_PAGE] += nowNanos() - stageStart;
 
-    FPDF_RenderPageBitmap( pdfBitmap, page,
-                           startX, startY,
-                           (int)drawSizeHor, (int)drawSizeVer,
-                           0, flags );
+    return rendered;
+}
 
-    if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
-        rgbBitmapTo565(tmp, sourceStride, addr, &info);
-        free(tmp);
+//Progressive render into an Android bitmap, pixels stay locked until the job is closed
+struct BitmapRenderJob {
+    RenderJob *job = NULL;
+    DocumentFile *doc = NULL;
+    jobject bitmap = NULL;
+    AndroidBitmapInfo info;
+    void *pixels = NULL;
+    //RGB_565 bitmaps are rendered as BGR here and converted once the job is done
+    void *bgrBuffer = NULL;
+    FPDF_BITMAP pdfBitmap = NULL;
+    bool dither = false;
+    //Finished renders are stored under this key; no RenderJob is created on a cache hit
+    RenderCacheKey cacheKey;
+};
+
+//Called with the document lock held, takes the engine itself
+static void closeBitmapRenderJob(JNIEnv *env, BitmapRenderJob *bitmapJob){
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        delete bitmapJob->job;
+        if(bitmapJob->pdfBitmap != NULL) {
+            FPDFBitmap_Destroy(bitmapJob->pdfBitmap);
+        }
     }
+    free(bitmapJob->bgrBuffer);
+    if(bitmapJob->pixels != NULL) {
+        AndroidBitmap_unlockPixels(env, bitmapJob->bitmap);
+    }
+    if(bitmapJob->bitmap != NULL) {
+        env->DeleteGlobalRef(bitmapJob->bitmap);
+    }
+    delete bitmapJob;
+}
 
-    AndroidBitmap_unlockPixels(env, bitmap);
-}*/
+static int updateBitmapRenderJob(BitmapRenderJob *bitmapJob, int status, int64_t startNanos){
+    RenderStats &stats = bitmapJob->doc->renderStats;
+    int64_t now = nowNanos();
+    stats.stageNanos[RENDER_STAGE_PAGE] += now - startNanos;
+
+    if(status == FPDF_RENDER_DONE) {
+        if(bitmapJob->bgrBuffer != NULL) {
+            const AndroidBitmapInfo &info = bitmapJob->info;
+            bgrTo565(bitmapJob->bgrBuffer, info.width * 3, bitmapJob->pixels, info.stride,
+                     info.width, info.height, bitmapJob->dither);
+            stats.conversionPasses++;
+            stats.stageNanos[RENDER_STAGE_CONVERT] += nowNanos() - now;
+        }
+        const AndroidBitmapInfo &info = bitmapJob->info;
+        int rowBytes = info.width * (info.format == ANDROID_BITMAP_FORMAT_RGB_565 ? 2 : 4);
+        storeCachedRender(bitmapJob->doc, bitmapJob->cacheKey, bitmapJob->pixels, info.stride, rowBytes);
+        stats.renderCount++;
+    }
+    return status;
+}
 
-JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong docPtr, jlong pagePtr, jobject bitmap,
-                                             jint dpi, jint startX, jint startY,
+JNI_FUNC(jlong, PdfiumCore, nativeRenderJobStart)(JNI_ARGS, jlong docPtr, jlong pagePtr, jint pageIndex,
+                                             jobject bitmap,
+                                             jint startX, jint startY,
                                              jint drawSizeHor, jint drawSizeVer,
-                                             jboolean renderAnnot){
+                                             jboolean renderAnnot, jboolean dither,
+                                             jlong budgetNanos){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
     FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
 
-    if(page == NULL || bitmap == NULL){
+    if(doc == NULL || page == NULL || bitmap == NULL){
         LOGE("Render page pointers invalid");
-        return;
+        return 0;
     }
 
-    AndroidBitmapInfo info;
+    CountedMutex::Autolock documentLock(doc->lock);
+    BitmapRenderJob *bitmapJob = new BitmapRenderJob();
+    bitmapJob->doc = doc;
+    bitmapJob->dither = dither;
+
     int ret;
+    AndroidBitmapInfo &info = bitmapJob->info;
     if((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
         LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
-        return;
+        delete bitmapJob;
+        return 0;
     }
-
-    int canvasHorSize = info.width;
-    int canvasVerSize = info.height;
-
     if(info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 && info.format != ANDROID_BITMAP_FORMAT_RGB_565){
         LOGE("Bitmap format must be RGBA_8888 or RGB_565");
-        return;
+        delete bitmapJob;
+        return 0;
     }
 
-    void *addr;
-    if( (ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0 ){
+    int64_t startNanos = nowNanos();
+    bitmapJob->bitmap = env->NewGlobalRef(bitmap);
+    if( (ret = AndroidBitmap_lockPixels(env, bitmap, &bitmapJob->pixels)) != 0 ){
         LOGE("Locking bitmap failed: %s", strerror(ret * -1));
-        return;
-    }
-
-    void *tmp;
-    int format;
-    int sourceStride;
-    if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
-        tmp = malloc(canvasVerSize * canvasHorSize * sizeof(rgb));
-        sourceStride = canvasHorSize * sizeof(rgb);
-        format = FPDFBitmap_BGR;
-    } else {
-        tmp = addr;
-        sourceStride = info.stride;
-        format = FPDFBitmap_BGRA;
+        bitmapJob->pixels = NULL;
+        closeBitmapRenderJob(env, bitmapJob);
+        return 0;
     }
 
-    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx( canvasHorSize, canvasVerSize,
-                                                     format, tmp, sourceStride);
-
-    /*LOGD("Start X: %d", startX);
-    LOGD("Start Y: %d", startY);
-    LOGD("Canvas Hor: %d", canvasHorSize);
-    LOGD("Canvas Ver: %d", canvasVerSize);
-    LOGD("Draw Hor: %d", drawSizeHor);
-    LOGD("Draw Ver: %d", drawSizeVer);*/
-
-    if(drawSizeHor < canvasHorSize || drawSizeVer < canvasVerSize){
-        FPDFBitmap_FillRect( pdfBitmap, 0, 0, canvasHorSize, canvasVerSize,
-                             0x848484FF); //Gray
+    RenderCacheKey &cacheKey = bitmapJob->cacheKey;
+    cacheKey.document = doc;
+    cacheKey.pageIndex = pageIndex;
+    cacheKey.flags = renderCacheFlags(renderAnnot, false, dither, info.format);
+    cacheKey.drawWidth = drawSizeHor;
+    cacheKey.drawHeight = drawSizeVer;
+    cacheKey.startX = startX;
+    cacheKey.startY = startY;
+    cacheKey.width = info.width;
+    cacheKey.height = info.height;
+    int rowBytes = info.width * (info.format == ANDROID_BITMAP_FORMAT_RGB_565 ? 2 : 4);
+    if(readCachedRender(doc, cacheKey, bitmapJob->pixels, info.stride, rowBytes)) {
+        doc->renderStats.stageNanos[RENDER_STAGE_LOCK] += nowNanos() - startNanos;
+        return reinterpret_cast<jlong>(bitmapJob);
     }
 
-    int baseHorSize = (canvasHorSize < drawSizeHor)? canvasHorSize : (int)drawSizeHor;
-    int baseVerSize = (canvasVerSize < drawSizeVer)? canvasVerSize : (int)drawSizeVer;
-    int baseX = (startX < 0)? 0 : (int)startX;
-    int baseY = (startY < 0)? 0 : (int)startY;
+    //Forms are not drawn progressively, so PDFium can write RGBA directly
     int flags = FPDF_REVERSE_BYTE_ORDER;
-
     if(renderAnnot) {
-    	flags |= FPDF_ANNOT;
+        flags |= FPDF_ANNOT;
     }
 
-    FPDFBitmap_FillRect( pdfBitmap, baseX, baseY, baseHorSize, baseVerSize,
-                         0xFFFFFFFF); //White
+    if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
+        bitmapJob->bgrBuffer = malloc((size_t)info.height * info.width * 3);
+        if (bitmapJob->bgrBuffer == NULL) {
+            LOGE("Cannot allocate RGB_565 conversion buffer");
+            closeBitmapRenderJob(env, bitmapJob);
+            return 0;
+        }
+        flags &= ~FPDF_REVERSE_BYTE_ORDER;
+    }
 
-    FPDF_RenderPageBitmap( pdfBitmap, page,
-                           startX, startY,
-                           (int)drawSizeHor, (int)drawSizeVer,
-                           0, flags );
+    int status;
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        if (bitmapJob->bgrBuffer != NULL) {
+            bitmapJob->pdfBitmap = FPDFBitmap_CreateEx(info.width, info.height, FPDFBitmap_BGR,
+                                                       bitmapJob->bgrBuffer, info.width * 3);
+        } else {
+            bitmapJob->pdfBitmap = FPDFBitmap_CreateEx(info.width, info.height, FPDFBitmap_BGRA,
+                                                       bitmapJob->pixels, info.stride);
+        }
 
-    /*if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
-        rgbBitmapTo565(tmp, sourceStride, addr, &info);
-        free(tmp);
-    }*/
+        fillPageBackground(bitmapJob->pdfBitmap, info.width, info.height,
+                           (int)startX, (int)startY, (int)drawSizeHor, (int)drawSizeVer);
+        doc->renderStats.stageNanos[RENDER_STAGE_LOCK] += nowNanos() - startNanos;
 
-    changeBitmapBR(info, addr);
-       PDFForm_Render(doc);
-       FORM_OnAfterLoadPage(page, doc->m_form);
-       FORM_DoPageAAction(page, doc->m_form, FPDFPAGE_AACTION_OPEN);
-       FPDF_FFLDraw(doc->m_form,
-                    pdfBitmap, page,
-                    startX, startY,
-                    (int)drawSizeHor, (int)drawSizeVer,
-                    0, flags );
+        startNanos = nowNanos();
+        bitmapJob->job = new RenderJob(page, bitmapJob->pdfBitmap);
+        status = bitmapJob->job->start((int)startX, (int)startY, (int)drawSizeHor, (int)drawSizeVer,
+                                       flags, (int64_t)budgetNanos);
+    }
+    updateBitmapRenderJob(bitmapJob, status, startNanos);
 
-        changeBitmapBR(info, addr);
+    return reinterpret_cast<jlong>(bitmapJob);
+}
 
-    AndroidBitmap_unlockPixels(env, bitmap);
+JNI_FUNC(jint, PdfiumCore, nativeRenderJobGetStatus)(JNI_ARGS, jlong jobPtr){
+    BitmapRenderJob *bitmapJob = reinterpret_cast<BitmapRenderJob*>(jobPtr);
+    CountedMutex::Autolock documentLock(bitmapJob->doc->lock);
+    return bitmapJob->job != NULL ? (jint)bitmapJob->job->getStatus() : FPDF_RENDER_DONE;
 }
 
-JNI_FUNC(jstring, PdfiumCore, nativeGetDocumentMetaText)(JNI_ARGS, jlong docPtr, jstring tag) {
-    const char *ctag = env->GetStringUTFChars(tag, NULL);
-    if (ctag == NULL) {
-        return env->NewStringUTF("");
+JNI_FUNC(jint, PdfiumCore, nativeRenderJobResume)(JNI_ARGS, jlong jobPtr, jlong budgetNanos){
+    BitmapRenderJob *bitmapJob = reinterpret_cast<BitmapRenderJob*>(jobPtr);
+    CountedMutex::Autolock documentLock(bitmapJob->doc->lock);
+    if(bitmapJob->job == NULL) {
+        return FPDF_RENDER_DONE;
     }
-    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    int64_t startNanos = nowNanos();
+    int status;
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        status = bitmapJob->job->resume((int64_t)budgetNanos);
+    }
+    return (jint)updateBitmapRenderJob(bitmapJob, status, startNanos);
+}
 
-    size_t bufferLen = FPDF_GetMetaText(doc->pdfDocument, ctag, NULL, 0);
-    if (bufferLen <= 2) {
-        return env->NewStringUTF("");
+//May be called from any thread while job is being resumed
+JNI_FUNC(void, PdfiumCore, nativeRenderJobCancel)(JNI_ARGS, jlong jobPtr){
+    BitmapRenderJob *bitmapJob = reinterpret_cast<BitmapRenderJob*>(jobPtr);
+    if(bitmapJob->job != NULL) {
+        bitmapJob->job->cancel();
     }
-    std::wstring text;
-    FPDF_GetMetaText(doc->pdfDocument, ctag, WriteInto(&text, bufferLen + 1), bufferLen);
-    env->ReleaseStringUTFChars(tag, ctag);
-    return env->NewString((jchar*) text.c_str(), bufferLen / 2 - 1);
 }
 
-JNI_FUNC(jobject, PdfiumCore, nativeGetFirstChildBookmark)(JNI_ARGS, jlong docPtr, jobject bookmarkPtr) {
-    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
-    FPDF_BOOKMARK parent;
-    if(bookmarkPtr == NULL) {
-        parent = NULL;
-    } else {
-        jclass longClass = env->GetObjectClass(bookmarkPtr);
-        jmethodID longValueMethod = env->GetMethodID(longClass, "longValue", "()J");
+JNI_FUNC(void, PdfiumCore, nativeRenderJobClose)(JNI_ARGS, jlong jobPtr){
+    BitmapRenderJob *bitmapJob = reinterpret_cast<BitmapRenderJob*>(jobPtr);
+    CountedMutex::Autolock documentLock(bitmapJob->doc->lock);
+    closeBitmapRenderJob(env, bitmapJob);
+}
 
-        jlong ptr = env->CallLongMethod(bookmarkPtr, longValueMethod);
-        parent = reinterpret_cast<FPDF_BOOKMARK>(ptr);
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetRenderStats)(JNI_ARGS, jlong docPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    RenderStats stats;
+    {
+        CountedMutex::Autolock documentLock(doc->lock);
+        stats = doc->renderStats;
     }
-    FPDF_BOOKMARK bookmark = FPDFBookmark_GetFirstChild(doc->pdfDocument, parent);
-    if (bookmark == NULL) {
+    const int counters = 8;
+    jlong values[counters + RENDER_STAGE_COUNT];
+    values[0] = stats.renderCount;
+    values[1] = stats.formRenderCount;
+    values[2] = stats.conversionPasses;
+    values[3] = stats.cacheHits;
+    values[4] = stats.cacheMisses;
+    values[5] = stats.diskCacheHits;
+    values[6] = stats.diskCacheMisses;
+    values[7] = stats.formSkipCount;
+    for (int i = 0; i < RENDER_STAGE_COUNT; i++) {
+        values[counters + i] = stats.stageNanos[i];
+    }
+
+    jlongArray result = env->NewLongArray(counters + RENDER_STAGE_COUNT);
+    if (result == NULL) {
         return NULL;
     }
-    return NewLong(env, reinterpret_cast<jlong>(bookmark));
+    env->SetLongArrayRegion(result, 0, counters + RENDER_STAGE_COUNT, values);
+    return result;
 }
 
-JNI_FUNC(jobject, PdfiumCore, nativeGetSiblingBookmark)(JNI_ARGS, jlong docPtr, jlong bookmarkPtr) {
+//[calls, bytes, failures, totalNanos, maxNanos, latency buckets..., offset buckets...]
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetIoStats)(JNI_ARGS, jlong docPtr){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
-    FPDF_BOOKMARK parent = reinterpret_cast<FPDF_BOOKMARK>(bookmarkPtr);
-    FPDF_BOOKMARK bookmark = FPDFBookmark_GetNextSibling(doc->pdfDocument, parent);
-    if (bookmark == NULL) {
+    IoStats stats = doc->ioStats.get();
+    const int counters = 5;
+    const int count = counters + IO_LATENCY_BUCKETS + IO_OFFSET_BUCKETS;
+    jlong values[count];
+    values[0] = stats.calls;
+    values[1] = stats.bytes;
+    values[2] = stats.failures;
+    values[3] = stats.totalNanos;
+    values[4] = stats.maxNanos;
+    for (int i = 0; i < IO_LATENCY_BUCKETS; i++) {
+        values[counters + i] = stats.latency[i];
+    }
+    for (int i = 0; i < IO_OFFSET_BUCKETS; i++) {
+        values[counters + IO_LATENCY_BUCKETS + i] = stats.offsets[i];
+    }
+
+    jlongArray result = env->NewLongArray(count);
+    if (result == NULL) {
         return NULL;
     }
-    return NewLong(env, reinterpret_cast<jlong>(bookmark));
+    env->SetLongArrayRegion(result, 0, count, values);
+    return result;
 }
 
-JNI_FUNC(jstring, PdfiumCore, nativeGetBookmarkTitle)(JNI_ARGS, jlong bookmarkPtr) {
-    FPDF_BOOKMARK bookmark = reinterpret_cast<FPDF_BOOKMARK>(bookmarkPtr);
-    size_t bufferLen = FPDFBookmark_GetTitle(bookmark, NULL, 0);
-    if (bufferLen <= 2) {
-        return env->NewStringUTF("");
-    }
-    std::wstring title;
-    FPDFBookmark_GetTitle(bookmark, WriteInto(&title, bufferLen + 1), bufferLen);
-    return env->NewString((jchar*) title.c_str(), bufferLen / 2 - 1);
+JNI_FUNC(void, PdfiumCore, nativeSetRenderCacheSize)(JNI_ARGS, jlong bytes){
+    sRenderCache.setBudget(bytes > 0 ? (size_t)bytes : 0);
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeGetRenderCacheUsed)(JNI_ARGS){
+    return (jlong)sRenderCache.getUsed();
 }
 
-JNI_FUNC(jlong, PdfiumCore, nativeGetBookmarkDestIndex)(JNI_ARGS, jlong docPtr, jlong bookmarkPtr) {
+JNI_FUNC(void, PdfiumCore, nativeSetBlockCacheSize)(JNI_ARGS, jlong bytes){
+    sBlockCacheBudget = bytes > 0 ? (size_t)bytes : 0;
+}
+
+//[hits, misses, syscalls, bytesRead] or null if document is not file backed
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetBlockCacheStats)(JNI_ARGS, jlong docPtr){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
-    FPDF_BOOKMARK bookmark = reinterpret_cast<FPDF_BOOKMARK>(bookmarkPtr);
+    if(doc == NULL || doc->blockCache == NULL) return NULL;
 
-    FPDF_DEST dest = FPDFBookmark_GetDest(doc->pdfDocument, bookmark);
-    if (dest == NULL) {
-        return -1;
+    BlockCacheStats stats = doc->blockCache->getStats();
+    jlong values[4] = { stats.hits, stats.misses, stats.syscalls, stats.bytesRead };
+    jlongArray result = env->NewLongArray(4);
+    if(result == NULL) return NULL;
+    env->SetLongArrayRegion(result, 0, 4, values);
+    return result;
+}
+
+static jlongArray lockStatsArray(JNIEnv *env, CountedMutex &mutex) {
+    LockStats stats = mutex.getStats();
+    jlong values[4] = { stats.acquisitions, stats.contentions, stats.waitNanos, stats.maxWaitNanos };
+    jlongArray result = env->NewLongArray(4);
+    if(result == NULL) return NULL;
+    env->SetLongArrayRegion(result, 0, 4, values);
+    return result;
+}
+
+//[acquisitions, contentions, waitNanos, maxWaitNanos] of the lock serializing PDFium calls
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetEngineLockStats)(JNI_ARGS){
+    return lockStatsArray(env, sEngineLock);
+}
+
+//[acquisitions, contentions, waitNanos, maxWaitNanos] of the document lock
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetDocumentLockStats)(JNI_ARGS, jlong docPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    return lockStatsArray(env, doc->lock);
+}
+
+//Descriptor of new shared memory for pixels rendered in a worker process, -1 on error
+JNI_FUNC(jint, PdfiumCore, nativeCreateSharedMemory)(JNI_ARGS, jint size){
+    if(size <= 0) return -1;
+    return createSharedMemory("pdfium-pixels", (size_t)size);
+}
+
+//Direct buffer over shared memory, release it with nativeUnmapSharedMemory
+JNI_FUNC(jobject, PdfiumCore, nativeMapSharedMemory)(JNI_ARGS, jint fd, jint size){
+    if(size <= 0) return NULL;
+    void *address = mapSharedMemory(fd, (size_t)size);
+    if(address == NULL) return NULL;
+    jobject buffer = env->NewDirectByteBuffer(address, size);
+    if(buffer == NULL) {
+        unmapSharedMemory(address, (size_t)size);
     }
-    return (jlong) FPDFDest_GetPageIndex(doc->pdfDocument, dest);
+    return buffer;
 }
 
-JNI_FUNC(jlongArray, PdfiumCore, nativeGetPageLinks)(JNI_ARGS, jlong pagePtr) {
+JNI_FUNC(void, PdfiumCore, nativeUnmapSharedMemory)(JNI_ARGS, jobject buffer){
+    unmapSharedMemory(env->GetDirectBufferAddress(buffer), (size_t)env->GetDirectBufferCapacity(buffer));
+}
+
+//Render whole page straight into direct buffer (e.g. mapped shared memory) as RGBA_8888 rows
+//without padding, the layout Bitmap.copyPixelsFromBuffer expects
+JNI_FUNC(jboolean, PdfiumCore, nativeRenderPageToBuffer)(JNI_ARGS, jlong docPtr, jlong pagePtr, jobject buffer,
+                                                   jint width, jint height, jboolean renderAnnot){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
     FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
-    int pos = 0;
-    std::vector<jlong> links;
-    FPDF_LINK link;
-    while (FPDFLink_Enumerate(page, &pos, &link)) {
-        links.push_back(reinterpret_cast<jlong>(link));
+    void *addr = buffer != NULL ? env->GetDirectBufferAddress(buffer) : NULL;
+    if(doc == NULL || page == NULL || addr == NULL || width <= 0 || height <= 0 ||
+       (jlong)width * height * 4 > env->GetDirectBufferCapacity(buffer)){
+        LOGE("Render page to buffer arguments invalid");
+        return JNI_FALSE;
     }
+    CountedMutex::Autolock documentLock(doc->lock);
+    CountedMutex::Autolock engine(sEngineLock);
 
-    jlongArray result = env->NewLongArray(links.size());
-    env->SetLongArrayRegion(result, 0, links.size(), &links[0]);
-    return result;
+    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(width, height, FPDFBitmap_BGRA, addr, width * 4);
+    if(pdfBitmap == NULL){
+        LOGE("Cannot wrap buffer in bitmap");
+        return JNI_FALSE;
+    }
+    FPDFBitmap_FillRect(pdfBitmap, 0, 0, width, height, 0xFFFFFFFF); //White
+
+    int flags = FPDF_REVERSE_BYTE_ORDER;
+    if(renderAnnot) {
+        flags |= FPDF_ANNOT;
+    }
+    FPDF_RenderPageBitmap(pdfBitmap, page, 0, 0, width, height, 0, flags);
+    FPDFBitmap_Destroy(pdfBitmap);
+    doc->renderStats.renderCount++;
+    return JNI_TRUE;
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeOpenDiskCache)(JNI_ARGS, jstring dir, jlong bytes){
+    const char *cdir = env->GetStringUTFChars(dir, NULL);
+    if(cdir == NULL) return JNI_FALSE;
+    bool opened = sDiskTileCache.open(cdir, bytes > 0 ? (size_t)bytes : 0);
+    env->ReleaseStringUTFChars(dir, cdir);
+    return (jboolean)opened;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeCloseDiskCache)(JNI_ARGS){
+    sDiskTileCache.close();
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeGetDiskCacheUsed)(JNI_ARGS){
+    return (jlong)sDiskTileCache.getUsed();
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeGetFileFingerprint)(JNI_ARGS, jint fd){
+    long fileSize = getFileSize(fd);
+    if(fileSize <= 0) return 0;
+    return (jlong)fingerprintFile(fd, (uint64_t)fileSize);
 }
 
-JNI_FUNC(jobject, PdfiumCore, nativeGetDestPageIndex)(JNI_ARGS, jlong docPtr, jlong linkPtr) {
+JNI_FUNC(jlong, PdfiumCore, nativeGetDocumentFingerprint)(JNI_ARGS, jlong docPtr){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
-    FPDF_LINK link = reinterpret_cast<FPDF_LINK>(linkPtr);
-    FPDF_DEST dest = FPDFLink_GetDest(doc->pdfDocument, link);
-    if (dest == NULL) {
+    return doc == NULL ? 0 : (jlong)doc->fingerprint;
+}
+
+//Size of the most recently cached whole page render: [drawWidth, drawHeight] or null
+JNI_FUNC(jintArray, PdfiumCore, nativeFindCachedPage)(JNI_ARGS, jlong fingerprint, jint pageIndex,
+                                                jboolean renderAnnot){
+    int flags = renderCacheFlags(renderAnnot, false, false, ANDROID_BITMAP_FORMAT_RGBA_8888);
+    int size[2];
+    if(fingerprint == 0 ||
+       !sDiskTileCache.findPage((uint64_t)fingerprint, pageIndex, flags, &size[0], &size[1])) {
         return NULL;
     }
-    unsigned long index = FPDFDest_GetPageIndex(doc->pdfDocument, dest);
-    return NewInteger(env, (jint) index);
+    jintArray result = env->NewIntArray(2);
+    if(result == NULL) return NULL;
+    env->SetIntArrayRegion(result, 0, 2, size);
+    return result;
 }
 
-JNI_FUNC(jstring, PdfiumCore, nativeGetLinkURI)(JNI_ARGS, jlong docPtr, jlong linkPtr){
-    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
-    FPDF_LINK link = reinterpret_cast<FPDF_LINK>(linkPtr);
-    FPDF_ACTION action = FPDFLink_GetAction(link);
-    if (action == NULL) {
-        return NULL;
+//Fill bitmap from disk cache only, without the document being loaded
+JNI_FUNC(jboolean, PdfiumCore, nativeRenderCachedPageBitmap)(JNI_ARGS, jlong fingerprint, jint pageIndex,
+                                                      jobject bitmap, jint startX, jint startY,
+                                                      jint drawSizeHor, jint drawSizeVer,
+                                                      jboolean renderAnnot, jboolean renderForm,
+                                                      jboolean dither){
+    if(fingerprint == 0 || bitmap == NULL) return JNI_FALSE;
+
+    AndroidBitmapInfo info;
+    int ret;
+    if((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
+        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+        return JNI_FALSE;
+    }
+    if(info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 && info.format != ANDROID_BITMAP_FORMAT_RGB_565){
+        return JNI_FALSE;
+    }
+
+    RenderCacheKey key;
+    key.document = NULL;
+    key.pageIndex = pageIndex;
+    key.flags = renderCacheFlags(renderAnnot, renderForm, dither, info.format);
+    key.drawWidth = drawSizeHor;
+    key.drawHeight = drawSizeVer;
+    key.startX = startX;
+    key.startY = startY;
+    key.width = info.width;
+    key.height = info.height;
+    DiskCacheKey diskKey;
+    toDiskCacheKey(key, (uint64_t)fingerprint, &diskKey);
+    int rowBytes = info.width * (info.format == ANDROID_BITMAP_FORMAT_RGB_565 ? 2 : 4);
+
+    void *addr;
+    if( (ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0 ){
+        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+        return JNI_FALSE;
+    }
+    bool found = sDiskTileCache.get(diskKey, addr, info.stride, rowBytes);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return (jboolean)found;
+}
+
+JNI_FUNC(jstring, PdfiumCore, nativeGetDocumentMetaText)(JNI_ARGS, jlong docPtr, jstring tag) {
+    const char *ctag = env->GetStringUTFChars(tag, NULL);
+    if (ctag == NULL) {
+        return env->NewStringUTF("");
     }
-    size_t bufferLen = FPDFAction_GetURIPath(doc->pdfDocument, action, NULL, 0);
-    if (bufferLen <= 0) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    CountedMutex::Autolock documentLock(doc->lock);
+    CountedMutex::Autolock engine(sEngineLock);
+
+    size_t bufferLen = FPDF_GetMetaText(doc->pdfDocument, ctag, NULL, 0);
+    if (bufferLen <= 2) {
         return env->NewStringUTF("");
     }
-    std::string uri;
-    FPDFAction_GetURIPath(doc->pdfDocument, action, WriteInto(&uri, bufferLen), bufferLen);
-    return env->NewStringUTF(uri.c_str());
+    std::wstring text;
+    FPDF_GetMetaText(doc->pdfDocument, ctag, WriteInto(&text, bufferLen + 1), bufferLen);
+    env->ReleaseStringUTFChars(tag, ctag);
+    return env->NewString((jchar*) text.c_str(), bufferLen / 2 - 1);
 }
 
-JNI_FUNC(jobject, PdfiumCore, nativeGetLinkRect)(JNI_ARGS, jlong linkPtr) {
-    FPDF_LINK link = reinterpret_cast<FPDF_LINK>(linkPtr);
-    FS_RECTF fsRectF;
-    FPDF_BOOL result = FPDFLink_GetAnnotRect(link, &fsRectF);
+//Whole outline in pre-order, parents before their children:
+//{int[] parents (-1 at top level), int[] depths, int[] pages (-1 without destination),
+// long[] bookmarks, int[] titleOffsets (count + 1), char[] titles}.
+//Titles are UTF-16 in one pool, title i spans titleOffsets[i] to titleOffsets[i + 1].
+//Each bookmark is visited once, so outlines whose child or sibling links loop still end.
+JNI_FUNC(jobjectArray, PdfiumCore, nativeGetOutline)(JNI_ARGS, jlong docPtr) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    CountedMutex::Autolock documentLock(doc->lock);
+    CountedMutex::Autolock engine(sEngineLock);
+    struct Pending {
+        FPDF_BOOKMARK bookmark;
+        jint parent;
+        jint depth;
+    };
+    std::vector<jint> parents, depths, pages, titleOffsets;
+    std::vector<jlong> bookmarks;
+    std::vector<jchar> titles;
+    std::unordered_set<FPDF_BOOKMARK> visited;
+    std::vector<jchar> title;
+
+    //Explicit stack, deeply nested outlines must not overflow the native stack
+    std::vector<Pending> stack;
+    Pending first = { FPDFBookmark_GetFirstChild(doc->pdfDocument, NULL), -1, 0 };
+    stack.push_back(first);
+    while(!stack.empty()) {
+        Pending pending = stack.back();
+        stack.pop_back();
+        if(pending.bookmark == NULL || !visited.insert(pending.bookmark).second) {
+            if(pending.bookmark != NULL) LOGD("Outline loops back to a visited bookmark");
+            continue;
+        }
+        jint index = (jint) parents.size();
+        parents.push_back(pending.parent);
+        depths.push_back(pending.depth);
+        bookmarks.push_back(reinterpret_cast<jlong>(pending.bookmark));
+
+        FPDF_DEST dest = FPDFBookmark_GetDest(doc->pdfDocument, pending.bookmark);
+        pages.push_back(dest != NULL ? (jint) FPDFDest_GetPageIndex(doc->pdfDocument, dest) : -1);
+
+        titleOffsets.push_back((jint) titles.size());
+        //Length in bytes of UTF-16LE title with terminator
+        unsigned long bufferLen = FPDFBookmark_GetTitle(pending.bookmark, NULL, 0);
+        if(bufferLen > 2) {
+            title.resize(bufferLen / 2);
+            FPDFBookmark_GetTitle(pending.bookmark, &title[0], bufferLen);
+            titles.insert(titles.end(), title.begin(), title.end() - 1);
+        }
 
-    if (!result) {
+        //Sibling is pushed first so the subtree comes next
+        Pending sibling = { FPDFBookmark_GetNextSibling(doc->pdfDocument, pending.bookmark),
+                            pending.parent, pending.depth };
+        Pending child = { FPDFBookmark_GetFirstChild(doc->pdfDocument, pending.bookmark),
+                          index, pending.depth + 1 };
+        stack.push_back(sibling);
+        stack.push_back(child);
+    }
+    titleOffsets.push_back((jint) titles.size());
+
+    jsize count = (jsize) parents.size();
+    jobjectArray result = env->NewObjectArray(6, sJni.objectClass, NULL);
+    jintArray parentArray = env->NewIntArray(count);
+    jintArray depthArray = env->NewIntArray(count);
+    jintArray pageArray = env->NewIntArray(count);
+    jlongArray bookmarkArray = env->NewLongArray(count);
+    jintArray offsetArray = env->NewIntArray(count + 1);
+    jcharArray titleArray = env->NewCharArray((jsize) titles.size());
+    if(result == NULL || parentArray == NULL || depthArray == NULL || pageArray == NULL ||
+       bookmarkArray == NULL || offsetArray == NULL || titleArray == NULL) {
         return NULL;
     }
+    if(count > 0) {
+        env->SetIntArrayRegion(parentArray, 0, count, &parents[0]);
+        env->SetIntArrayRegion(depthArray, 0, count, &depths[0]);
+        env->SetIntArrayRegion(pageArray, 0, count, &pages[0]);
+        env->SetLongArrayRegion(bookmarkArray, 0, count, &bookmarks[0]);
+    }
+    env->SetIntArrayRegion(offsetArray, 0, count + 1, &titleOffsets[0]);
+    if(!titles.empty()) {
+        env->SetCharArrayRegion(titleArray, 0, (jsize) titles.size(), &titles[0]);
+    }
+    env->SetObjectArrayElement(result, 0, parentArray);
+    env->SetObjectArrayElement(result, 1, depthArray);
+    env->SetObjectArrayElement(result, 2, pageArray);
+    env->SetObjectArrayElement(result, 3, bookmarkArray);
+    env->SetObjectArrayElement(result, 4, offsetArray);
+    env->SetObjectArrayElement(result, 5, titleArray);
+    return result;
+}
 
-    jclass clazz = env->FindClass("android/graphics/RectF");
-    jmethodID constructorID = env->GetMethodID(clazz, "<init>", "(FFFF)V");
-    return env->NewObject(clazz, constructorID, fsRectF.left, fsRectF.top, fsRectF.right, fsRectF.bottom);
+//All links of loaded page in one result: {float[] rects, int[] info, float[] quads, String[] uris},
+//see PageLinks for layout
+JNI_FUNC(jobjectArray, PdfiumCore, nativeGetPageLinkTable)(JNI_ARGS, jlong docPtr, jlong pagePtr) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    //Links stay in the document's cache, which the document lock guards while they are copied
+    CountedMutex::Autolock documentLock(doc->lock);
+    const PageLinks *cached;
+    {
+        CountedMutex::Autolock engine(sEngineLock);
+        cached = &doc->getPageLinks(reinterpret_cast<FPDF_PAGE>(pagePtr));
+    }
+    const PageLinks &links = *cached;
+
+    jobjectArray result = env->NewObjectArray(4, sJni.objectClass, NULL);
+    jfloatArray rects = env->NewFloatArray((jsize)links.rects.size());
+    jintArray info = env->NewIntArray((jsize)links.info.size());
+    jfloatArray quads = env->NewFloatArray((jsize)links.quads.size());
+    jobjectArray uris = env->NewObjectArray((jsize)links.uris.size(), sJni.stringClass, NULL);
+    if(result == NULL || rects == NULL || info == NULL || quads == NULL || uris == NULL) {
+        return NULL;
+    }
+    if(!links.rects.empty()) {
+        env->SetFloatArrayRegion(rects, 0, (jsize)links.rects.size(), &links.rects[0]);
+        env->SetIntArrayRegion(info, 0, (jsize)links.info.size(), &links.info[0]);
+    }
+    if(!links.quads.empty()) {
+        env->SetFloatArrayRegion(quads, 0, (jsize)links.quads.size(), &links.quads[0]);
+    }
+    for(size_t i = 0; i < links.uris.size(); i++) {
+        jstring uri = env->NewStringUTF(links.uris[i].c_str());
+        env->SetObjectArrayElement(uris, (jsize)i, uri);
+        env->DeleteLocalRef(uri);
+    }
+    env->SetObjectArrayElement(result, 0, rects);
+    env->SetObjectArrayElement(result, 1, info);
+    env->SetObjectArrayElement(result, 2, quads);
+    env->SetObjectArrayElement(result, 3, uris);
+    return result;
 }
 
 JNI_FUNC(jobject, PdfiumCore, nativePageCoordsToDevice)(JNI_ARGS, jlong pagePtr, jint startX, jint startY, jint sizeX,
@@ -842,11 +2356,10 @@ JNI_FUNC(jobject, PdfiumCore, nativePageCoordsToDevice)(JNI_ARGS, jlong pagePtr,
     FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
     int deviceX, deviceY;
 
+    CountedMutex::Autolock engine(sEngineLock);
     FPDF_PageToDevice(page, startX, startY, sizeX, sizeY, rotate, pageX, pageY, &deviceX, &deviceY);
 
-    jclass clazz = env->FindClass("android/graphics/Point");
-    jmethodID constructorID = env->GetMethodID(clazz, "<init>", "(II)V");
-    return env->NewObject(clazz, constructorID, deviceX, deviceY);
+    return env->NewObject(sJni.pointClass, sJni.pointInit, deviceX, deviceY);
 }
 
 JNI_FUNC(jobject, PdfiumCore, nativeDeviceCoordsToPage)(JNI_ARGS, jlong pagePtr, jint startX, jint startY, jint sizeX,
@@ -854,11 +2367,10 @@ JNI_FUNC(jobject, PdfiumCore, nativeDeviceCoordsToPage)(JNI_ARGS, jlong pagePtr,
     FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
     double pageX, pageY;
 
+    CountedMutex::Autolock engine(sEngineLock);
     FPDF_DeviceToPage(page, startX, startY, sizeX, sizeY, rotate, deviceX, deviceY, &pageX, &pageY);
 
-    jclass clazz = env->FindClass("android/graphics/PointF");
-    jmethodID constructorID = env->GetMethodID(clazz, "<init>", "(FF)V");
-    return env->NewObject(clazz, constructorID, pageX, pageY);
+    return env->NewObject(sJni.pointFClass, sJni.pointFInit, pageX, pageY);
 }
 
 //////////////////////////////////////////
@@ -870,7 +2382,11 @@ static jlong loadTextPageInternal(JNIEnv *env, DocumentFile *doc, jlong pagePtr)
 
         FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
         if(page != NULL){
-            FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
+            FPDF_TEXTPAGE textPage;
+            {
+                CountedMutex::Autolock engine(sEngineLock);
+                textPage = FPDFText_LoadPage(page);
+            }
             if (textPage == NULL) {
                 throw "Loaded text page is null";
             }
@@ -888,7 +2404,10 @@ static jlong loadTextPageInternal(JNIEnv *env, DocumentFile *doc, jlong pagePtr)
     }
 }
 
-static void closeTextPageInternal(jlong textPagePtr) { FPDFText_ClosePage(reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr)); }
+static void closeTextPageInternal(jlong textPagePtr) {
+    CountedMutex::Autolock engine(sEngineLock);
+    FPDFText_ClosePage(reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr));
+}
 
 JNI_FUNC(jlong, PdfiumCore, nativeLoadTextPage)(JNI_ARGS, jlong docPtr, jlong pagePtr){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
@@ -923,12 +2442,14 @@ JNI_FUNC(void, PdfiumCore, nativeCloseTextPages)(JNI_ARGS, jlongArray textPagesP
 //DLLEXPORT int STDCALL FPDFText_CountChars(FPDF_TEXTPAGE text_page);
 JNI_FUNC(jint, PdfiumCore, nativeTextCountChars)(JNI_ARGS, jlong textPagePtr){
     FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(textPagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     return (jint)FPDFText_CountChars(textPage);
 }
 
 //DLLEXPORT unsigned int STDCALL FPDFText_GetUnicode(FPDF_TEXTPAGE text_page, int index);
 JNI_FUNC(jint, PdfiumCore, nativeTextGetUnicode)(JNI_ARGS, jlong textPagePtr, jint index){
     FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(textPagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     return (jint)FPDFText_GetUnicode(textPage, (int)index);
 }
 
@@ -940,6 +2461,7 @@ JNI_FUNC(jint, PdfiumCore, nativeTextGetUnicode)(JNI_ARGS, jlong textPagePtr, ji
                                            double* top);*/
 JNI_FUNC(jdoubleArray, PdfiumCore, nativeTextGetCharBox)(JNI_ARGS, jlong textPagePtr, jint index){
     FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(textPagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     jdoubleArray result = env->NewDoubleArray(4);
     if (result == NULL) {
         return NULL;
@@ -950,6 +2472,51 @@ JNI_FUNC(jdoubleArray, PdfiumCore, nativeTextGetCharBox)(JNI_ARGS, jlong textPag
     return result;
 }
 
+//Whole page in one call: UTF-16 text, [left, top, right, bottom] float boxes and optional
+//float font sizes per char, written from the start of direct buffers in native byte order.
+//Returns number of chars; when a buffer is too small nothing is written.
+JNI_FUNC(jint, PdfiumCore, nativeTextExtract)(JNI_ARGS, jlong textPagePtr, jobject textBuffer,
+                                              jobject boxBuffer, jobject fontSizeBuffer){
+    FPDF_TEXTPAGE textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
+    int count = FPDFText_CountChars(textPage);
+    if(count <= 0) return 0;
+
+    uint16_t *text = (uint16_t*) env->GetDirectBufferAddress(textBuffer);
+    float *boxes = (float*) env->GetDirectBufferAddress(boxBuffer);
+    float *fontSizes = fontSizeBuffer != NULL ?
+                       (float*) env->GetDirectBufferAddress(fontSizeBuffer) : NULL;
+    if(text == NULL || boxes == NULL || (fontSizeBuffer != NULL && fontSizes == NULL)) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "Buffers must be direct");
+        return -1;
+    }
+    if(env->GetDirectBufferCapacity(textBuffer) < (jlong)count * 2 ||
+       env->GetDirectBufferCapacity(boxBuffer) < (jlong)count * 4 * sizeof(float) ||
+       (fontSizes != NULL && env->GetDirectBufferCapacity(fontSizeBuffer) < (jlong)count * sizeof(float))) {
+        return count;
+    }
+
+    //FPDFText_GetText writes a terminating zero past the chars
+    std::vector<unsigned short> chars((size_t)count + 1);
+    int written = FPDFText_GetText(textPage, 0, count, &chars[0]);
+    if(written > 0) written--;
+    memcpy(text, &chars[0], (size_t)written * 2);
+    memset(text + written, 0, (size_t)(count - written) * 2);
+
+    for(int i = 0; i < count; i++, boxes += 4) {
+        double left, right, bottom, top;
+        FPDFText_GetCharBox(textPage, i, &left, &right, &bottom, &top);
+        boxes[0] = (float)left;
+        boxes[1] = (float)top;
+        boxes[2] = (float)right;
+        boxes[3] = (float)bottom;
+        if(fontSizes != NULL) {
+            fontSizes[i] = (float)FPDFText_GetFontSize(textPage, i);
+        }
+    }
+    return count;
+}
+
 /*DLLEXPORT int STDCALL FPDFText_GetCharIndexAtPos(FPDF_TEXTPAGE text_page,
                                                  double x,
                                                  double y,
@@ -957,6 +2524,7 @@ JNI_FUNC(jdoubleArray, PdfiumCore, nativeTextGetCharBox)(JNI_ARGS, jlong textPag
                                                  double yTolerance);*/
 JNI_FUNC(jint, PdfiumCore, nativeTextGetCharIndexAtPos)(JNI_ARGS, jlong textPagePtr, jdouble x, jdouble y, jdouble xTolerance, jdouble yTolerance){
     FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(textPagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     return (jint)FPDFText_GetCharIndexAtPos(textPage, (double)x, (double)y, (double)xTolerance, (double)yTolerance);
 }
 
@@ -966,6 +2534,7 @@ JNI_FUNC(jint, PdfiumCore, nativeTextGetCharIndexAtPos)(JNI_ARGS, jlong textPage
                                        unsigned short* result);*/
 JNI_FUNC(jint, PdfiumCore, nativeTextGetText)(JNI_ARGS, jlong textPagePtr, jint start_index, jint count, jshortArray result){
     FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(textPagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     jboolean isCopy = 0;
     unsigned short *arr = (unsigned short *)env->GetShortArrayElements(result, &isCopy);
     jint output = (jint)FPDFText_GetText(textPage, (int)start_index, (int)count, arr);
@@ -981,6 +2550,7 @@ JNI_FUNC(jint, PdfiumCore, nativeTextGetText)(JNI_ARGS, jlong textPagePtr, jint
                                           int count);*/
 JNI_FUNC(jint, PdfiumCore, nativeTextCountRects)(JNI_ARGS, jlong textPagePtr, jint start_index, jint count){
     FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(textPagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     return (jint)FPDFText_CountRects(textPage, (int)start_index, (int) count);
 }
 
@@ -992,6 +2562,7 @@ JNI_FUNC(jint, PdfiumCore, nativeTextCountRects)(JNI_ARGS, jlong textPagePtr, ji
                                         double* bottom);*/
 JNI_FUNC(jdoubleArray, PdfiumCore, nativeTextGetRect)(JNI_ARGS, jlong textPagePtr, jint rect_index){
     FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(textPagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     jdoubleArray result = env->NewDoubleArray(4);
     if (result == NULL) {
         return NULL;
@@ -1013,6 +2584,7 @@ JNI_FUNC(jdoubleArray, PdfiumCore, nativeTextGetRect)(JNI_ARGS, jlong textPagePt
 
 JNI_FUNC(jint, PdfiumCore, nativeTextGetBoundedText)(JNI_ARGS, jlong textPagePtr, jdouble left, jdouble top, jdouble right, jdouble bottom, jshortArray arr){
     FPDF_TEXTPAGE *textPage = reinterpret_cast<FPDF_TEXTPAGE*>(textPagePtr);
+    CountedMutex::Autolock engine(sEngineLock);
     jboolean isCopy = 0;
     unsigned short *buffer = NULL;
     int bufLen = 0;
@@ -1028,4 +2600,105 @@ JNI_FUNC(jint, PdfiumCore, nativeTextGetBoundedText)(JNI_ARGS, jlong textPagePtr
     return output;
 }
 
+#define NATIVE_METHOD(name, signature) \
+    { #name, signature, reinterpret_cast<void*>(Java_com_shockwave_pdfium_PdfiumCore_##name) }
+
+//Bound explicitly, so calls skip lookup of mangled symbol names
+static const JNINativeMethod sPdfiumCoreMethods[] = {
+    NATIVE_METHOD(nativeOpenDocument, "(ILjava/lang/String;Z)J"),
+    NATIVE_METHOD(nativeOpenMemDocument, "([BLjava/lang/String;)J"),
+    NATIVE_METHOD(nativeOpenDirectBufferDocument, "(Ljava/nio/ByteBuffer;IILjava/lang/String;)J"),
+    NATIVE_METHOD(nativeOpenSourceDocument, "(Lcom/shockwave/pdfium/DocumentSource;JLjava/lang/String;)J"),
+    NATIVE_METHOD(nativeOpenProgressiveDocument, "(J)J"),
+    NATIVE_METHOD(nativeProgressiveAddData, "(JJ[BII)Z"),
+    NATIVE_METHOD(nativeProgressiveGetRequests, "(J)[J"),
+    NATIVE_METHOD(nativeProgressiveGetAvailableBytes, "(J)J"),
+    NATIVE_METHOD(nativeProgressiveLoad, "(JLjava/lang/String;)I"),
+    NATIVE_METHOD(nativeProgressiveIsPageAvail, "(JI)I"),
+    NATIVE_METHOD(nativeProgressiveGetFirstPage, "(J)I"),
+    NATIVE_METHOD(nativeCloseDocument, "(J)V"),
+    NATIVE_METHOD(nativeSetRetainedDocuments, "(I)V"),
+    NATIVE_METHOD(nativeGetPageCount, "(J)I"),
+    NATIVE_METHOD(nativeHasForm, "(J)Z"),
+    NATIVE_METHOD(nativeLoadPage, "(JI)J"),
+    NATIVE_METHOD(nativeLoadPages, "(JII)[J"),
+    NATIVE_METHOD(nativeClosePage, "(JJ)V"),
+    NATIVE_METHOD(nativeClosePages, "(J[J)V"),
+    NATIVE_METHOD(nativeGetPageWidthPixel, "(JI)I"),
+    NATIVE_METHOD(nativeGetPageHeightPixel, "(JI)I"),
+    NATIVE_METHOD(nativeGetPageWidthPoint, "(J)I"),
+    NATIVE_METHOD(nativeGetPageHeightPoint, "(J)I"),
+    NATIVE_METHOD(nativeRenderPage, "(JLandroid/view/Surface;IIIIIZ)V"),
+    NATIVE_METHOD(nativeRenderPageBitmap, "(JJILandroid/graphics/Bitmap;IIIIIZZZ)V"),
+    NATIVE_METHOD(nativeRenderPageTile, "(JJIFIIILandroid/graphics/Bitmap;ZZZ)V"),
+    NATIVE_METHOD(nativeLayoutThumbnails, "(JIIII)[I"),
+    NATIVE_METHOD(nativeRenderThumbnails, "(JII[ILandroid/graphics/Bitmap;Z)I"),
+    NATIVE_METHOD(nativeRenderJobStart, "(JJILandroid/graphics/Bitmap;IIIIZZJ)J"),
+    NATIVE_METHOD(nativeRenderJobGetStatus, "(J)I"),
+    NATIVE_METHOD(nativeRenderJobResume, "(JJ)I"),
+    NATIVE_METHOD(nativeRenderJobCancel, "(J)V"),
+    NATIVE_METHOD(nativeRenderJobClose, "(J)V"),
+    NATIVE_METHOD(nativeGetRenderStats, "(J)[J"),
+    NATIVE_METHOD(nativeGetIoStats, "(J)[J"),
+    NATIVE_METHOD(nativeSetRenderCacheSize, "(J)V"),
+    NATIVE_METHOD(nativeGetRenderCacheUsed, "()J"),
+    NATIVE_METHOD(nativeSetBlockCacheSize, "(J)V"),
+    NATIVE_METHOD(nativeGetBlockCacheStats, "(J)[J"),
+    NATIVE_METHOD(nativeGetEngineLockStats, "()[J"),
+    NATIVE_METHOD(nativeGetDocumentLockStats, "(J)[J"),
+    NATIVE_METHOD(nativeCreateSharedMemory, "(I)I"),
+    NATIVE_METHOD(nativeMapSharedMemory, "(II)Ljava/nio/ByteBuffer;"),
+    NATIVE_METHOD(nativeUnmapSharedMemory, "(Ljava/nio/ByteBuffer;)V"),
+    NATIVE_METHOD(nativeRenderPageToBuffer, "(JJLjava/nio/ByteBuffer;IIZ)Z"),
+    NATIVE_METHOD(nativeOpenDiskCache, "(Ljava/lang/String;J)Z"),
+    NATIVE_METHOD(nativeCloseDiskCache, "()V"),
+    NATIVE_METHOD(nativeGetDiskCacheUsed, "()J"),
+    NATIVE_METHOD(nativeGetFileFingerprint, "(I)J"),
+    NATIVE_METHOD(nativeGetDocumentFingerprint, "(J)J"),
+    NATIVE_METHOD(nativeFindCachedPage, "(JIZ)[I"),
+    NATIVE_METHOD(nativeRenderCachedPageBitmap, "(JILandroid/graphics/Bitmap;IIIIZZZ)Z"),
+    NATIVE_METHOD(nativeGetDocumentMetaText, "(JLjava/lang/String;)Ljava/lang/String;"),
+    NATIVE_METHOD(nativeGetOutline, "(J)[Ljava/lang/Object;"),
+    NATIVE_METHOD(nativeLoadTextPage, "(JJ)J"),
+    NATIVE_METHOD(nativeCloseTextPage, "(J)V"),
+    NATIVE_METHOD(nativeTextCountChars, "(J)I"),
+    NATIVE_METHOD(nativeTextGetText, "(JII[S)I"),
+    NATIVE_METHOD(nativeTextGetUnicode, "(JI)I"),
+    NATIVE_METHOD(nativeTextGetCharBox, "(JI)[D"),
+    NATIVE_METHOD(nativeTextExtract, "(JLjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;)I"),
+    NATIVE_METHOD(nativeTextGetCharIndexAtPos, "(JDDDD)I"),
+    NATIVE_METHOD(nativeTextCountRects, "(JII)I"),
+    NATIVE_METHOD(nativeTextGetRect, "(JI)[D"),
+    NATIVE_METHOD(nativeTextGetBoundedText, "(JDDDD[S)I"),
+    NATIVE_METHOD(nativeGetPageSizeByIndex, "(JII)Lcom/shockwave/pdfium/util/Size;"),
+    NATIVE_METHOD(nativeGetAllPageSizes, "(J)[F"),
+    NATIVE_METHOD(nativeGetPageLinkTable, "(JJ)[Ljava/lang/Object;"),
+    NATIVE_METHOD(nativePageCoordsToDevice, "(JIIIIIDD)Landroid/graphics/Point;"),
+    NATIVE_METHOD(nativeDeviceCoordsToPage, "(JIIIIIII)Landroid/graphics/PointF;"),
+};
+
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved){
+    JNIEnv *env;
+    if(vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    if(!cacheClasses(env)) {
+        LOGE("Cannot cache classes used by natives");
+        return JNI_ERR;
+    }
+
+    jclass coreClass = env->FindClass("com/shockwave/pdfium/PdfiumCore");
+    if(coreClass == NULL) {
+        return JNI_ERR;
+    }
+    jint registered = env->RegisterNatives(coreClass, sPdfiumCoreMethods,
+                                           sizeof(sPdfiumCoreMethods) / sizeof(sPdfiumCoreMethods[0]));
+    env->DeleteLocalRef(coreClass);
+    if(registered != JNI_OK) {
+        LOGE("Cannot register natives");
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_6;
+}
+
 }//extern C
@@ -0,0 +1,321 @@
+#include "pixelConvert.hpp"
+
+extern "C" {
+    #include <pthread.h>
+    #include <string.h>
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXEL_HAVE_NEON 1
+#include <arm_neon.h>
+#if defined(__ANDROID__) && defined(__arm__)
+#include <cpu-features.h>
+#endif
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+#define PIXEL_HAVE_X86 1
+#include <immintrin.h>
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+typedef void (*SwizzleRowFunc)(uint32_t *row, int width);
+//dither is NULL or 4 bytes of per-pixel thresholds for current row, repeated every 4 pixels
+typedef void (*Bgr565RowFunc)(const uint8_t *src, uint16_t *dst, int width, const uint8_t *dither);
+
+struct PixelKernels {
+    SwizzleRowFunc swizzleRow;
+    Bgr565RowFunc bgr565Row;
+};
+
+//4x4 Bayer matrix, values 0..15
+static const uint8_t sBayer[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+static inline uint32_t swapRB(uint32_t v) {
+    return (v & 0xFF00FF00) | ((v >> 16) & 0xFF) | ((v & 0xFF) << 16);
+}
+
+static void swizzleRowScalar(uint32_t *row, int width) {
+    for (int x = 0; x < width; x++) {
+        row[x] = swapRB(row[x]);
+    }
+}
+
+static inline uint8_t addSaturate(uint8_t v, uint8_t d) {
+    int sum = v + d;
+    return sum > 255 ? 255 : (uint8_t) sum;
+}
+
+//Thresholds are scaled to the bits dropped by each channel: 3 for red/blue, 2 for green
+static inline uint16_t pixelTo565(const uint8_t *bgr, uint8_t threshold) {
+    uint8_t b = addSaturate(bgr[0], threshold >> 1);
+    uint8_t g = addSaturate(bgr[1], threshold >> 2);
+    uint8_t r = addSaturate(bgr[2], threshold >> 1);
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+static void bgr565RowScalar(const uint8_t *src, uint16_t *dst, int width, const uint8_t *dither) {
+    if (dither == NULL) {
+        for (int x = 0; x < width; x++, src += 3) {
+            dst[x] = ((src[2] >> 3) << 11) | ((src[1] >> 2) << 5) | (src[0] >> 3);
+        }
+    } else {
+        for (int x = 0; x < width; x++, src += 3) {
+            dst[x] = pixelTo565(src, dither[x & 3]);
+        }
+    }
+}
+
+#ifdef PIXEL_HAVE_NEON
+static void swizzleRowNeon(uint32_t *row, int width) {
+    uint8_t *p = (uint8_t*) row;
+    int x = 0;
+    for (; x + 16 <= width; x += 16, p += 64) {
+        uint8x16x4_t px = vld4q_u8(p);
+        uint8x16_t tmp = px.val[0];
+        px.val[0] = px.val[2];
+        px.val[2] = tmp;
+        vst4q_u8(p, px);
+    }
+    swizzleRowScalar(row + x, width - x);
+}
+
+static void bgr565RowNeon(const uint8_t *src, uint16_t *dst, int width, const uint8_t *dither) {
+    uint8x16_t ditherRB = vdupq_n_u8(0);
+    uint8x16_t ditherG = vdupq_n_u8(0);
+    if (dither != NULL) {
+        uint8_t rb[16], g[16];
+        for (int i = 0; i < 16; i++) {
+            rb[i] = dither[i & 3] >> 1;
+            g[i] = dither[i & 3] >> 2;
+        }
+        ditherRB = vld1q_u8(rb);
+        ditherG = vld1q_u8(g);
+    }
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16, src += 48) {
+        uint8x16x3_t px = vld3q_u8(src);
+        uint8x16_t b = vqaddq_u8(px.val[0], ditherRB);
+        uint8x16_t g = vqaddq_u8(px.val[1], ditherG);
+        uint8x16_t r = vqaddq_u8(px.val[2], ditherRB);
+
+        uint16x8_t lo = vsriq_n_u16(vshll_n_u8(vget_low_u8(r), 8), vshll_n_u8(vget_low_u8(g), 8), 5);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(b), 8), 11);
+        uint16x8_t hi = vsriq_n_u16(vshll_n_u8(vget_high_u8(r), 8), vshll_n_u8(vget_high_u8(g), 8), 5);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(b), 8), 11);
+
+        vst1q_u16(dst + x, lo);
+        vst1q_u16(dst + x + 8, hi);
+    }
+    //16 is a multiple of the dither period, so the tail keeps its phase
+    bgr565RowScalar(src, dst + x, width - x, dither);
+}
+#endif
+
+#ifdef PIXEL_HAVE_X86
+TARGET_SSSE3 static void swizzleRowSsse3(uint32_t *row, int width) {
+    const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i *p = (__m128i*) (row + x);
+        _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), mask));
+    }
+    swizzleRowScalar(row + x, width - x);
+}
+
+TARGET_AVX2 static void swizzleRowAvx2(uint32_t *row, int width) {
+    const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                          2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i *p = (__m256i*) (row + x);
+        _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), mask));
+    }
+    swizzleRowScalar(row + x, width - x);
+}
+
+//Dither thresholds of 4 pixels laid out as [b, g, r, 0] bytes, matching expanded pixels
+static inline void expandDither(const uint8_t *dither, uint8_t *out) {
+    for (int i = 0; i < 4; i++) {
+        uint8_t t = dither != NULL ? dither[i] : 0;
+        out[i * 4 + 0] = t >> 1;
+        out[i * 4 + 1] = t >> 2;
+        out[i * 4 + 2] = t >> 1;
+        out[i * 4 + 3] = 0;
+    }
+}
+
+//Pixels in 32-bit lanes as B | G << 8 | R << 16, result in low 16 bits of each lane
+TARGET_SSSE3 static inline __m128i lanesTo565Ssse3(__m128i v) {
+    __m128i r = _mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0xF800));
+    __m128i g = _mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x07E0));
+    __m128i b = _mm_and_si128(_mm_srli_epi32(v, 3), _mm_set1_epi32(0x001F));
+    return _mm_or_si128(r, _mm_or_si128(g, b));
+}
+
+TARGET_SSSE3 static void bgr565RowSsse3(const uint8_t *src, uint16_t *dst, int width, const uint8_t *dither) {
+    const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i pack = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    uint8_t thresholds[16];
+    expandDither(dither, thresholds);
+    const __m128i ditherVec = _mm_loadu_si128((const __m128i*) thresholds);
+
+    int x = 0;
+    //Each 16-byte load covers 5.3 pixels, keep loads inside the row
+    for (; x + 10 <= width; x += 8, src += 24) {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) src), expand);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (src + 12)), expand);
+        a = lanesTo565Ssse3(_mm_adds_epu8(a, ditherVec));
+        b = lanesTo565Ssse3(_mm_adds_epu8(b, ditherVec));
+        __m128i out = _mm_unpacklo_epi64(_mm_shuffle_epi8(a, pack), _mm_shuffle_epi8(b, pack));
+        _mm_storeu_si128((__m128i*) (dst + x), out);
+    }
+    bgr565RowScalar(src, dst + x, width - x, dither);
+}
+
+TARGET_AVX2 static void bgr565RowAvx2(const uint8_t *src, uint16_t *dst, int width, const uint8_t *dither) {
+    const __m256i expand = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i pack = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    uint8_t thresholds[16];
+    expandDither(dither, thresholds);
+    const __m256i ditherVec = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) thresholds));
+
+    int x = 0;
+    for (; x + 18 <= width; x += 16, src += 48) {
+        __m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) src)),
+                                            _mm_loadu_si128((const __m128i*) (src + 12)), 1);
+        __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) (src + 24))),
+                                            _mm_loadu_si128((const __m128i*) (src + 36)), 1);
+        a = _mm256_adds_epu8(_mm256_shuffle_epi8(a, expand), ditherVec);
+        b = _mm256_adds_epu8(_mm256_shuffle_epi8(b, expand), ditherVec);
+
+        __m256i ra = _mm256_and_si256(_mm256_srli_epi32(a, 8), _mm256_set1_epi32(0xF800));
+        __m256i ga = _mm256_and_si256(_mm256_srli_epi32(a, 5), _mm256_set1_epi32(0x07E0));
+        __m256i ba = _mm256_and_si256(_mm256_srli_epi32(a, 3), _mm256_set1_epi32(0x001F));
+        __m256i rb = _mm256_and_si256(_mm256_srli_epi32(b, 8), _mm256_set1_epi32(0xF800));
+        __m256i gb = _mm256_and_si256(_mm256_srli_epi32(b, 5), _mm256_set1_epi32(0x07E0));
+        __m256i bb = _mm256_and_si256(_mm256_srli_epi32(b, 3), _mm256_set1_epi32(0x001F));
+        a = _mm256_shuffle_epi8(_mm256_or_si256(ra, _mm256_or_si256(ga, ba)), pack);
+        b = _mm256_shuffle_epi8(_mm256_or_si256(rb, _mm256_or_si256(gb, bb)), pack);
+
+        //Packed pixels are in the low 8 bytes of each 128-bit lane
+        __m256i out = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i*) (dst + x), out);
+    }
+    bgr565RowScalar(src, dst + x, width - x, dither);
+}
+#endif
+
+static const PixelKernels sKernels[PIXEL_BACKEND_COUNT] = {
+    /* PIXEL_BACKEND_SCALAR */ { swizzleRowScalar, bgr565RowScalar },
+#ifdef PIXEL_HAVE_NEON
+    /* PIXEL_BACKEND_NEON */   { swizzleRowNeon, bgr565RowNeon },
+#else
+    /* PIXEL_BACKEND_NEON */   { NULL, NULL },
+#endif
+#ifdef PIXEL_HAVE_X86
+    /* PIXEL_BACKEND_SSSE3 */  { swizzleRowSsse3, bgr565RowSsse3 },
+    /* PIXEL_BACKEND_AVX2 */   { swizzleRowAvx2, bgr565RowAvx2 },
+#else
+    /* PIXEL_BACKEND_SSSE3 */  { NULL, NULL },
+    /* PIXEL_BACKEND_AVX2 */   { NULL, NULL },
+#endif
+};
+
+static pthread_once_t sInitOnce = PTHREAD_ONCE_INIT;
+static PixelBackend sBackend = PIXEL_BACKEND_SCALAR;
+
+bool pixelBackendSupported(PixelBackend backend) {
+    switch (backend) {
+        case PIXEL_BACKEND_SCALAR:
+            return true;
+#ifdef PIXEL_HAVE_NEON
+        case PIXEL_BACKEND_NEON:
+#if defined(__ANDROID__) && defined(__arm__)
+            return android_getCpuFamily() == ANDROID_CPU_FAMILY_ARM &&
+                   (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON) != 0;
+#else
+            return true;
+#endif
+#endif
+#ifdef PIXEL_HAVE_X86
+        case PIXEL_BACKEND_SSSE3:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("ssse3");
+        case PIXEL_BACKEND_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static void detectBackend() {
+    static const PixelBackend preferred[] = {
+        PIXEL_BACKEND_AVX2, PIXEL_BACKEND_SSSE3, PIXEL_BACKEND_NEON
+    };
+    for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); i++) {
+        if (pixelBackendSupported(preferred[i])) {
+            sBackend = preferred[i];
+            return;
+        }
+    }
+    sBackend = PIXEL_BACKEND_SCALAR;
+}
+
+static inline const PixelKernels& kernels() {
+    pthread_once(&sInitOnce, detectBackend);
+    return sKernels[sBackend];
+}
+
+PixelBackend pixelBackend() {
+    pthread_once(&sInitOnce, detectBackend);
+    return sBackend;
+}
+
+const char* pixelBackendName(PixelBackend backend) {
+    switch (backend) {
+        case PIXEL_BACKEND_SCALAR: return "scalar";
+        case PIXEL_BACKEND_NEON: return "neon";
+        case PIXEL_BACKEND_SSSE3: return "ssse3";
+        case PIXEL_BACKEND_AVX2: return "avx2";
+        default: return "unknown";
+    }
+}
+
+bool pixelSelectBackend(PixelBackend backend) {
+    pthread_once(&sInitOnce, detectBackend);
+    if (!pixelBackendSupported(backend)) {
+        return false;
+    }
+    sBackend = backend;
+    return true;
+}
+
+void swizzleRB(void *pixels, int width, int height, int stride) {
+    SwizzleRowFunc swizzleRow = kernels().swizzleRow;
+    uint8_t *row = (uint8_t*) pixels;
+    for (int y = 0; y < height; y++, row += stride) {
+        swizzleRow((uint32_t*) row, width);
+    }
+}
+
+void bgrTo565(const void *src, int srcStride, void *dst, int dstStride,
+              int width, int height, bool dither) {
+    Bgr565RowFunc bgr565Row = kernels().bgr565Row;
+    const uint8_t *srcRow = (const uint8_t*) src;
+    uint8_t *dstRow = (uint8_t*) dst;
+    for (int y = 0; y < height; y++, srcRow += srcStride, dstRow += dstStride) {
+        bgr565Row(srcRow, (uint16_t*) dstRow, width, dither ? sBayer[y & 3] : NULL);
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef _PIXEL_CONVERT_HPP_
+#define _PIXEL_CONVERT_HPP_
+
+#include <stdint.h>
+
+/*
+ * Pixel format conversion kernels used on the render path.
+ * Each kernel has a scalar version and SIMD versions (NEON on arm, SSSE3/AVX2 on x86);
+ * the fastest one supported by the running CPU is picked on first use.
+ * Rows are always walked by stride, so padded bitmaps are handled correctly.
+ */
+
+enum PixelBackend {
+    PIXEL_BACKEND_SCALAR = 0,
+    PIXEL_BACKEND_NEON,
+    PIXEL_BACKEND_SSSE3,
+    PIXEL_BACKEND_AVX2,
+    PIXEL_BACKEND_COUNT
+};
+
+/** Swap R and B channels of 32-bit pixels in place (RGBA <-> BGRA) */
+void swizzleRB(void *pixels, int width, int height, int stride);
+
+/**
+ * Convert 24-bit pixels in FPDFBitmap_BGR memory order into RGB_565.
+ * With dither enabled a 4x4 ordered (Bayer) matrix is applied before truncation,
+ * which hides banding on gradients and scanned images.
+ */
+void bgrTo565(const void *src, int srcStride, void *dst, int dstStride,
+              int width, int height, bool dither);
+
+/** Backend currently used by the kernels */
+PixelBackend pixelBackend();
+
+const char* pixelBackendName(PixelBackend backend);
+
+bool pixelBackendSupported(PixelBackend backend);
+
+/** Force given backend (e.g. for benchmarks). Returns false if not supported by this CPU. */
+bool pixelSelectBackend(PixelBackend backend);
+
+#endif
@@ -0,0 +1,180 @@
+#include "util.hpp"
+#include "progressiveSource.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+using namespace android;
+
+ProgressiveSource::ProgressiveSource(uint64_t fileSize)
+    : fileSize(fileSize), data(NULL), presentBytes(0) {
+    fileAvail.avail.version = 1;
+    fileAvail.avail.IsDataAvail = &isDataAvail;
+    fileAvail.source = this;
+    downloadHints.hints.version = 1;
+    downloadHints.hints.AddSegment = &addSegment;
+    downloadHints.source = this;
+}
+
+ProgressiveSource::~ProgressiveSource() {
+    free(data);
+}
+
+bool ProgressiveSource::init() {
+    if (fileSize == 0 || fileSize > SIZE_MAX) {
+        return false;
+    }
+    data = (uint8_t*) malloc((size_t) fileSize);
+    return data != NULL;
+}
+
+FPDF_FILEACCESS ProgressiveSource::getFileAccess() {
+    FPDF_FILEACCESS access;
+    access.m_FileLen = (unsigned long) fileSize;
+    access.m_GetBlock = &getBlock;
+    access.m_Param = this;
+    return access;
+}
+
+bool ProgressiveSource::addData(uint64_t offset, const void *bytes, size_t size) {
+    if (offset > fileSize || size > fileSize - offset) {
+        LOGE("Data of %zu bytes at %llu is past end of file", size, (unsigned long long) offset);
+        return false;
+    }
+    if (size == 0) {
+        return true;
+    }
+
+    Mutex::Autolock autolock(lock);
+    //Bytes are in place before their range is published
+    memcpy(data + offset, bytes, size);
+
+    uint64_t start = offset;
+    uint64_t end = offset + size;
+    //Merge with ranges overlapping or touching [start, end)
+    std::map<uint64_t, uint64_t>::iterator it = present.upper_bound(start);
+    if (it != present.begin()) {
+        std::map<uint64_t, uint64_t>::iterator previous = it;
+        --previous;
+        if (previous->second >= start) {
+            it = previous;
+        }
+    }
+    while (it != present.end() && it->first <= end) {
+        if (it->first < start) start = it->first;
+        if (it->second > end) end = it->second;
+        presentBytes -= it->second - it->first;
+        present.erase(it++);
+    }
+    present[start] = end;
+    presentBytes += end - start;
+    return true;
+}
+
+bool ProgressiveSource::isAvailableLocked(uint64_t offset, uint64_t size) {
+    if (size == 0) {
+        return true;
+    }
+    std::map<uint64_t, uint64_t>::iterator it = present.upper_bound(offset);
+    if (it == present.begin()) {
+        return false;
+    }
+    --it;
+    return it->first <= offset && it->second >= offset + size;
+}
+
+bool ProgressiveSource::isAvailable(uint64_t offset, uint64_t size) {
+    Mutex::Autolock autolock(lock);
+    return isAvailableLocked(offset, size);
+}
+
+bool ProgressiveSource::isComplete() {
+    Mutex::Autolock autolock(lock);
+    return presentBytes == fileSize;
+}
+
+uint64_t ProgressiveSource::getAvailableBytes() {
+    Mutex::Autolock autolock(lock);
+    return presentBytes;
+}
+
+void ProgressiveSource::request(uint64_t offset, uint64_t size) {
+    if (offset >= fileSize) {
+        return;
+    }
+    if (size > fileSize - offset) {
+        size = fileSize - offset;
+    }
+
+    Mutex::Autolock autolock(lock);
+    //Walk the gaps between present ranges inside [offset, offset + size)
+    uint64_t position = offset;
+    uint64_t end = offset + size;
+    std::map<uint64_t, uint64_t>::iterator it = present.upper_bound(position);
+    if (it != present.begin()) {
+        std::map<uint64_t, uint64_t>::iterator previous = it;
+        --previous;
+        if (previous->second > position) {
+            position = previous->second;
+        }
+    }
+    while (position < end) {
+        uint64_t gapEnd = (it != present.end() && it->first < end) ? it->first : end;
+        if (gapEnd > position) {
+            bool queued = false;
+            for (size_t i = 0; i < requests.size(); i++) {
+                if (requests[i].offset <= position &&
+                    requests[i].offset + requests[i].size >= gapEnd) {
+                    queued = true;
+                    break;
+                }
+            }
+            if (!queued) {
+                ByteRange range;
+                range.offset = position;
+                range.size = gapEnd - position;
+                requests.push_back(range);
+            }
+        }
+        if (it == present.end()) break;
+        position = it->second;
+        ++it;
+    }
+}
+
+std::vector<ByteRange> ProgressiveSource::takeRequests() {
+    Mutex::Autolock autolock(lock);
+    std::vector<ByteRange> taken;
+    taken.swap(requests);
+    return taken;
+}
+
+bool ProgressiveSource::read(uint64_t position, void *out, size_t size) {
+    Mutex::Autolock autolock(lock);
+    if (position > fileSize || size > fileSize - position || !isAvailableLocked(position, size)) {
+        return false;
+    }
+    memcpy(out, data + position, size);
+    return true;
+}
+
+FPDF_BOOL ProgressiveSource::isDataAvail(FX_FILEAVAIL *avail, size_t offset, size_t size) {
+    ProgressiveSource *source = reinterpret_cast<FileAvail*>(avail)->source;
+    return source->isAvailable(offset, size) ? 1 : 0;
+}
+
+void ProgressiveSource::addSegment(FX_DOWNLOADHINTS *hints, size_t offset, size_t size) {
+    ProgressiveSource *source = reinterpret_cast<DownloadHints*>(hints)->source;
+    source->request(offset, size);
+}
+
+int ProgressiveSource::getBlock(void *param, unsigned long position, unsigned char *outBuffer,
+                                unsigned long size) {
+    ProgressiveSource *source = reinterpret_cast<ProgressiveSource*>(param);
+    if (!source->read(position, outBuffer, size)) {
+        LOGE("Parser read %lu bytes at %lu which have not arrived", size, position);
+        return 0;
+    }
+    return 1;
+}
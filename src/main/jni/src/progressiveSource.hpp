@@ -0,0 +1,90 @@
+#ifndef _PROGRESSIVE_SOURCE_HPP_
+#define _PROGRESSIVE_SOURCE_HPP_
+
+#include <utils/Mutex.h>
+
+extern "C" {
+    #include <fpdfview.h>
+    #include <fpdf_dataavail.h>
+}
+
+#include <map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ByteRange {
+    uint64_t offset;
+    uint64_t size;
+};
+
+/**
+ * Document data which arrives over time, e.g. downloaded in ranges.
+ * Bytes are stored at their offsets in a buffer of the full file size, and the ranges
+ * present are tracked so FPDFAvail can ask whether a section is available. Sections the
+ * library still needs come in as download hints; they are queued, minus the parts already
+ * present, until the caller takes them. Data can be added from any thread.
+ */
+class ProgressiveSource {
+    public:
+    explicit ProgressiveSource(uint64_t fileSize);
+    ~ProgressiveSource();
+
+    /** Allocate the buffer, returns false if out of memory */
+    bool init();
+
+    uint64_t getFileSize() { return fileSize; }
+
+    /** Store bytes at offset and mark them present */
+    bool addData(uint64_t offset, const void *data, size_t size);
+
+    bool isAvailable(uint64_t offset, uint64_t size);
+
+    /** All bytes present */
+    bool isComplete();
+
+    uint64_t getAvailableBytes();
+
+    /** Queue missing parts of given range, unless already queued */
+    void request(uint64_t offset, uint64_t size);
+
+    /** Take queued requests */
+    std::vector<ByteRange> takeRequests();
+
+    /** Copy present bytes, returns false if some are missing */
+    bool read(uint64_t position, void *out, size_t size);
+
+    FX_FILEAVAIL* getFileAvail() { return &fileAvail.avail; }
+    FX_DOWNLOADHINTS* getDownloadHints() { return &downloadHints.hints; }
+    FPDF_FILEACCESS getFileAccess();
+
+    private:
+    //PDFium passes the interface back, the wrappers lead to the source
+    struct FileAvail {
+        FX_FILEAVAIL avail;
+        ProgressiveSource *source;
+    };
+    struct DownloadHints {
+        FX_DOWNLOADHINTS hints;
+        ProgressiveSource *source;
+    };
+
+    android::Mutex lock;
+    uint64_t fileSize;
+    uint8_t *data;
+    //Present ranges, start -> end, never overlapping or touching
+    std::map<uint64_t, uint64_t> present;
+    uint64_t presentBytes;
+    std::vector<ByteRange> requests;
+    FileAvail fileAvail;
+    DownloadHints downloadHints;
+
+    bool isAvailableLocked(uint64_t offset, uint64_t size);
+
+    static FPDF_BOOL isDataAvail(FX_FILEAVAIL *avail, size_t offset, size_t size);
+    static void addSegment(FX_DOWNLOADHINTS *hints, size_t offset, size_t size);
+    static int getBlock(void *param, unsigned long position, unsigned char *outBuffer,
+                        unsigned long size);
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "renderCache.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <string.h>
+}
+
+using namespace android;
+
+RenderCache sRenderCache;
+
+bool RenderCacheKey::operator==(const RenderCacheKey &other) const {
+    return document == other.document && pageIndex == other.pageIndex && flags == other.flags &&
+           drawWidth == other.drawWidth && drawHeight == other.drawHeight &&
+           startX == other.startX && startY == other.startY &&
+           width == other.width && height == other.height;
+}
+
+size_t RenderCacheKeyHash::operator()(const RenderCacheKey &key) const {
+    size_t hash = reinterpret_cast<uintptr_t>(key.document);
+    const int fields[] = { key.pageIndex, key.flags, key.drawWidth, key.drawHeight,
+                           key.startX, key.startY, key.width, key.height };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        hash = hash * 31 + (size_t) fields[i];
+    }
+    return hash;
+}
+
+RenderCache::~RenderCache() {
+    for (EntryList::iterator it = entries.begin(); it != entries.end(); ++it) {
+        free(it->pixels);
+    }
+}
+
+void RenderCache::setBudget(size_t bytes) {
+    Mutex::Autolock autolock(lock);
+    budget = bytes;
+    trimTo(budget);
+}
+
+size_t RenderCache::getBudget() {
+    Mutex::Autolock autolock(lock);
+    return budget;
+}
+
+size_t RenderCache::getUsed() {
+    Mutex::Autolock autolock(lock);
+    return used;
+}
+
+bool RenderCache::get(const RenderCacheKey &key, void *dest, int destStride, int rowBytes) {
+    Mutex::Autolock autolock(lock);
+    auto found = index.find(key);
+    if (found == index.end()) {
+        return false;
+    }
+
+    EntryList::iterator it = found->second;
+    entries.splice(entries.begin(), entries, it);
+
+    const uint8_t *src = it->pixels;
+    uint8_t *dst = (uint8_t*) dest;
+    for (int y = 0; y < key.height; y++, src += rowBytes, dst += destStride) {
+        memcpy(dst, src, rowBytes);
+    }
+    return true;
+}
+
+void RenderCache::put(const RenderCacheKey &key, const void *src, int srcStride, int rowBytes) {
+    size_t size = (size_t) rowBytes * key.height;
+
+    Mutex::Autolock autolock(lock);
+    if (size > budget) {
+        return;
+    }
+    auto found = index.find(key);
+    if (found != index.end()) {
+        evict(found->second);
+    }
+    trimTo(budget - size);
+
+    uint8_t *pixels = (uint8_t*) malloc(size);
+    if (pixels == NULL) {
+        return;
+    }
+    const uint8_t *srcRow = (const uint8_t*) src;
+    for (int y = 0; y < key.height; y++, srcRow += srcStride) {
+        memcpy(pixels + (size_t) y * rowBytes, srcRow, rowBytes);
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.pixels = pixels;
+    entry.size = size;
+    entries.push_front(entry);
+    index[key] = entries.begin();
+    used += size;
+}
+
+void RenderCache::removeDocument(const void *document) {
+    Mutex::Autolock autolock(lock);
+    EntryList::iterator it = entries.begin();
+    while (it != entries.end()) {
+        EntryList::iterator next = it;
+        ++next;
+        if (it->key.document == document) {
+            evict(it);
+        }
+        it = next;
+    }
+}
+
+void RenderCache::evict(EntryList::iterator it) {
+    used -= it->size;
+    free(it->pixels);
+    index.erase(it->key);
+    entries.erase(it);
+}
+
+void RenderCache::trimTo(size_t bytes) {
+    while (used > bytes && !entries.empty()) {
+        EntryList::iterator last = entries.end();
+        --last;
+        evict(last);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef _RENDER_CACHE_HPP_
+#define _RENDER_CACHE_HPP_
+
+#include <utils/Mutex.h>
+
+#include <list>
+#include <unordered_map>
+#include <stddef.h>
+#include <stdint.h>
+
+//Identifies one rendered bitmap: page fragment at given page pixel size, target size and flags
+struct RenderCacheKey {
+    const void *document;
+    int pageIndex;
+    int flags;
+    //Size of the whole page in pixels, i.e. zoom bucket
+    int drawWidth;
+    int drawHeight;
+    //Region of the page
+    int startX;
+    int startY;
+    int width;
+    int height;
+
+    bool operator==(const RenderCacheKey &other) const;
+};
+
+struct RenderCacheKeyHash {
+    size_t operator()(const RenderCacheKey &key) const;
+};
+
+/**
+ * Process-wide LRU cache of rendered pixels with a byte budget.
+ * Budget of 0 disables the cache. All methods are thread-safe.
+ */
+class RenderCache {
+    public:
+    RenderCache() : budget(0), used(0) {}
+    ~RenderCache();
+
+    void setBudget(size_t bytes);
+    size_t getBudget();
+    size_t getUsed();
+
+    /** Copy cached rows into dest; returns false on miss */
+    bool get(const RenderCacheKey &key, void *dest, int destStride, int rowBytes);
+
+    /** Store a copy of given rows, evicting least recently used entries to stay in budget */
+    void put(const RenderCacheKey &key, const void *src, int srcStride, int rowBytes);
+
+    /** Drop all entries of given document */
+    void removeDocument(const void *document);
+
+    private:
+    struct Entry {
+        RenderCacheKey key;
+        uint8_t *pixels;
+        size_t size;
+    };
+    typedef std::list<Entry> EntryList;
+
+    android::Mutex lock;
+    size_t budget;
+    size_t used;
+    EntryList entries; //most recently used first
+    std::unordered_map<RenderCacheKey, EntryList::iterator, RenderCacheKeyHash> index;
+
+    void evict(EntryList::iterator it);
+    void trimTo(size_t bytes);
+};
+
+extern RenderCache sRenderCache;
+
+#endif
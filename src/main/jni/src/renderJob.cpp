@@ -0,0 +1,49 @@
+#include "renderJob.hpp"
+#include "util.hpp"
+
+RenderJob::RenderJob(FPDF_PAGE page, FPDF_BITMAP bitmap) : cancelled(false), page(page), bitmap(bitmap) {
+    pause.version = 1;
+    pause.NeedToPauseNow = &RenderJob::needToPauseNow;
+    pause.user = this;
+}
+
+RenderJob::~RenderJob() {
+    if(started) {
+        FPDF_RenderPage_Close(page);
+    }
+}
+
+FPDF_BOOL RenderJob::needToPauseNow(IFSDK_PAUSE *pause) {
+    RenderJob *job = static_cast<RenderJob*>(pause->user);
+    return job->isCancelled() || nowNanos() >= job->deadline;
+}
+
+int RenderJob::updateStatus(int renderStatus) {
+    if(renderStatus == FPDF_RENDER_TOBECOUNTINUED && isCancelled()) {
+        status = RENDER_JOB_CANCELLED;
+    } else {
+        status = renderStatus;
+    }
+    return status;
+}
+
+int RenderJob::start(int startX, int startY, int sizeX, int sizeY, int flags, int64_t budgetNanos) {
+    if(started) {
+        return status;
+    }
+    started = true;
+    deadline = nowNanos() + budgetNanos;
+    return updateStatus(FPDF_RenderPageBitmap_Start(bitmap, page, startX, startY, sizeX, sizeY,
+                                                    0, flags, &pause));
+}
+
+int RenderJob::resume(int64_t budgetNanos) {
+    if(status != FPDF_RENDER_TOBECOUNTINUED) {
+        return status;
+    }
+    if(isCancelled()) {
+        return updateStatus(status);
+    }
+    deadline = nowNanos() + budgetNanos;
+    return updateStatus(FPDF_RenderPage_Continue(page, &pause));
+}
@@ -0,0 +1,44 @@
+#ifndef _RENDER_JOB_HPP_
+#define _RENDER_JOB_HPP_
+
+#include <fpdfview.h>
+#include <fpdf_progressive.h>
+
+#include <atomic>
+
+//FPDF_RENDER_TOBECOUNTINUED, FPDF_RENDER_DONE and FPDF_RENDER_FAILED are reported as they are
+#define RENDER_JOB_CANCELLED 4
+
+/**
+ * Progressive render of a page into a PDFium bitmap.
+ * Work is done in slices limited by a time budget; between slices the job can be
+ * cancelled from any thread, or left paused and resumed later.
+ * Start and resume must be serialized with other PDFium calls, cancel does not need to be.
+ */
+class RenderJob {
+    public:
+    RenderJob(FPDF_PAGE page, FPDF_BITMAP bitmap);
+    ~RenderJob();
+
+    int start(int startX, int startY, int sizeX, int sizeY, int flags, int64_t budgetNanos);
+    int resume(int64_t budgetNanos);
+
+    void cancel() { cancelled.store(true); }
+    bool isCancelled() const { return cancelled.load(); }
+    int getStatus() const { return status; }
+
+    private:
+    IFSDK_PAUSE pause;
+    std::atomic<bool> cancelled;
+    int64_t deadline = 0;
+    int status = FPDF_RENDER_READER;
+    bool started = false;
+
+    FPDF_PAGE page;
+    FPDF_BITMAP bitmap;
+
+    static FPDF_BOOL needToPauseNow(IFSDK_PAUSE *pause);
+    int updateStatus(int renderStatus);
+};
+
+#endif
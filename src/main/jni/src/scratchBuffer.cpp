@@ -0,0 +1,47 @@
+#include "scratchBuffer.hpp"
+
+extern "C" {
+    #include <pthread.h>
+    #include <stdlib.h>
+}
+
+struct ScratchBuffer {
+    void *data;
+    size_t capacity;
+};
+
+static pthread_key_t sScratchKey;
+static pthread_once_t sScratchKeyOnce = PTHREAD_ONCE_INIT;
+
+static void destroyScratchBuffer(void *value) {
+    ScratchBuffer *buffer = static_cast<ScratchBuffer*>(value);
+    free(buffer->data);
+    delete buffer;
+}
+
+static void createScratchKey() {
+    pthread_key_create(&sScratchKey, destroyScratchBuffer);
+}
+
+static ScratchBuffer* threadScratchBuffer() {
+    pthread_once(&sScratchKeyOnce, createScratchKey);
+    ScratchBuffer *buffer = static_cast<ScratchBuffer*>(pthread_getspecific(sScratchKey));
+    if (buffer == NULL) {
+        buffer = new ScratchBuffer();
+        buffer->data = NULL;
+        buffer->capacity = 0;
+        pthread_setspecific(sScratchKey, buffer);
+    }
+    return buffer;
+}
+
+void* acquireScratchBuffer(size_t size) {
+    ScratchBuffer *buffer = threadScratchBuffer();
+    if (size > buffer->capacity) {
+        //Contents are not preserved, so avoid realloc copying them
+        free(buffer->data);
+        buffer->data = malloc(size);
+        buffer->capacity = buffer->data != NULL ? size : 0;
+    }
+    return buffer->data;
+}
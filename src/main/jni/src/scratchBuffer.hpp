@@ -0,0 +1,14 @@
+#ifndef _SCRATCH_BUFFER_HPP_
+#define _SCRATCH_BUFFER_HPP_
+
+#include <stddef.h>
+
+/**
+ * Per-thread scratch memory for intermediate render buffers.
+ * The buffer only grows, to the largest size requested on the calling thread,
+ * and is freed when the thread exits. Returned memory is valid until the next
+ * call on the same thread.
+ */
+void* acquireScratchBuffer(size_t size);
+
+#endif
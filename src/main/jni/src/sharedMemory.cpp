@@ -0,0 +1,78 @@
+#include "util.hpp"
+#include "sharedMemory.hpp"
+
+extern "C" {
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <string.h>
+    #include <sys/ioctl.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #include <linux/ashmem.h>
+}
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+//memfd_create has no libc wrapper before API 30, kernels older than 3.17 do not have it at all
+static int createMemfd(const char *name, size_t size) {
+#ifdef __NR_memfd_create
+    int fd = (int) syscall(__NR_memfd_create, name, MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, (off_t) size) != 0) {
+        LOGE("Cannot resize memfd to %zu bytes. Error:%d", size, errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static int createAshmem(const char *name, size_t size) {
+    int fd = open("/dev/ashmem", O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("Cannot open ashmem. Error:%d", errno);
+        return -1;
+    }
+    char buffer[ASHMEM_NAME_LEN];
+    strncpy(buffer, name, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = 0;
+    if (ioctl(fd, ASHMEM_SET_NAME, buffer) < 0 || ioctl(fd, ASHMEM_SET_SIZE, size) < 0) {
+        LOGE("Cannot set up ashmem of %zu bytes. Error:%d", size, errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int createSharedMemory(const char *name, size_t size) {
+    if (size == 0) {
+        return -1;
+    }
+    int fd = createMemfd(name, size);
+    if (fd < 0) {
+        fd = createAshmem(name, size);
+    }
+    return fd;
+}
+
+void *mapSharedMemory(int fd, size_t size) {
+    void *address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        LOGE("Cannot map %zu bytes of shared memory. Error:%d", size, errno);
+        return NULL;
+    }
+    return address;
+}
+
+void unmapSharedMemory(void *address, size_t size) {
+    if (address != NULL) {
+        munmap(address, size);
+    }
+}
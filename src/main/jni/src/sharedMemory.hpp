@@ -0,0 +1,18 @@
+#ifndef _SHARED_MEMORY_HPP_
+#define _SHARED_MEMORY_HPP_
+
+#include <stddef.h>
+
+/**
+ * Create anonymous shared memory of size bytes, which can be passed to another process as
+ * file descriptor and mapped there. Uses memfd where the kernel has it and ashmem otherwise.
+ * Returns descriptor owned by caller or -1 on error.
+ */
+int createSharedMemory(const char *name, size_t size);
+
+/** Map shared memory read-write, returns NULL on error */
+void *mapSharedMemory(int fd, size_t size);
+
+void unmapSharedMemory(void *address, size_t size);
+
+#endif
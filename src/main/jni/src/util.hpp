@@ -4,6 +4,8 @@
 #include <jni.h>
 extern "C" {
     #include <stdlib.h>
+    #include <stdint.h>
+    #include <time.h>
 }
 
 #include <android/log.h>
@@ -16,4 +18,10 @@ extern "C" {
 #define LOGE(...)   __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 #define LOGD(...)   __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 
+static inline int64_t nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 #endif
\ No newline at end of file